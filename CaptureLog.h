@@ -0,0 +1,152 @@
+/*
+  ==============================================================================
+
+    Capture of live input for offline reproduction.
+
+    The audio thread appends whole records to a preallocated ring buffer, all
+    or nothing and without waiting: if the ring is full the record is dropped
+    and the caller notes a gap. A background thread polls the ring ten times
+    a second and spills it to disk; the audio thread never signals it, since
+    waking a thread takes a lock.
+
+    File layout: the 8 byte magic, then records of
+        uint8 type, uint32 payload size, payload
+    in native byte order. The payloads are defined by NewProjectAudioProcessor
+    and are only meant to be read back by the same build.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+namespace CaptureLog
+{
+    static constexpr char magic[8] = { 'M', 'V', 'V', 'C', 'A', 'P', '0', '2' };
+
+    enum class RecordType : juce::uint8
+    {
+        snapshot = 1,   // sample rate, block size and the processor's note history
+        block = 2,      // one processBlock call: settings, input and output events
+        gap = 3         // records were dropped here, wait for the next snapshot
+    };
+
+    struct Chunk
+    {
+        const void* data;
+        size_t size;
+    };
+}
+
+//==============================================================================
+class CaptureWriter : private juce::Thread
+{
+public:
+    // Creates the file and starts the writer thread. Message thread only.
+    explicit CaptureWriter(const juce::File& fileToWrite, int ringBytes = 4 * 1024 * 1024)
+        : juce::Thread("Capture writer"),
+          file(fileToWrite),
+          fifo(ringBytes)
+    {
+        ring.allocate((size_t) ringBytes, false);
+
+        file.deleteFile();
+        stream = file.createOutputStream();
+
+        if (stream != nullptr)
+        {
+            stream->write(CaptureLog::magic, sizeof(CaptureLog::magic));
+            startThread();
+        }
+    }
+
+    ~CaptureWriter() override
+    {
+        stopThread(2000);
+        drain();
+    }
+
+    bool isOpen() const noexcept                    { return stream != nullptr; }
+    const juce::File& getFile() const noexcept      { return file; }
+
+    // Audio thread. Returns false, writing nothing, if the whole record doesn't fit.
+    bool writeRecord(CaptureLog::RecordType type, std::initializer_list<CaptureLog::Chunk> chunks) noexcept
+    {
+        size_t size = 0;
+
+        for (auto& chunk : chunks)
+            size += chunk.size;
+
+        if (! beginRecord(type, size))
+            return false;
+
+        for (auto& chunk : chunks)
+            append(chunk.data, chunk.size);
+
+        return true;
+    }
+
+    // Audio thread. For records built piece by piece: if this returns true, exactly
+    // payloadSize bytes must follow through append(), there is guaranteed room for them.
+    bool beginRecord(CaptureLog::RecordType type, size_t payloadSize) noexcept
+    {
+        const auto total = sizeof(juce::uint8) + sizeof(juce::uint32) + payloadSize;
+
+        if (stream == nullptr || (size_t) fifo.getFreeSpace() < total)
+            return false;
+
+        const auto typeByte = (juce::uint8) type;
+        const auto size = (juce::uint32) payloadSize;
+        append(&typeByte, sizeof(typeByte));
+        append(&size, sizeof(size));
+        return true;
+    }
+
+    void append(const void* data, size_t size) noexcept
+    {
+        const auto scope = fifo.write((int) size);
+        auto* source = static_cast<const char*> (data);
+
+        if (scope.blockSize1 > 0)
+            memcpy(ring + scope.startIndex1, source, (size_t) scope.blockSize1);
+
+        if (scope.blockSize2 > 0)
+            memcpy(ring + scope.startIndex2, source + scope.blockSize1, (size_t) scope.blockSize2);
+    }
+
+private:
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            wait(100);
+            drain();
+        }
+    }
+
+    void drain()
+    {
+        if (stream == nullptr)
+            return;
+
+        const auto scope = fifo.read(fifo.getNumReady());
+
+        if (scope.blockSize1 > 0)
+            stream->write(ring + scope.startIndex1, (size_t) scope.blockSize1);
+
+        if (scope.blockSize2 > 0)
+            stream->write(ring + scope.startIndex2, (size_t) scope.blockSize2);
+
+        stream->flush();
+    }
+
+    const juce::File file;
+    std::unique_ptr<juce::FileOutputStream> stream;
+
+    juce::AbstractFifo fifo;
+    juce::HeapBlock<char> ring;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CaptureWriter)
+};
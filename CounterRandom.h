@@ -0,0 +1,48 @@
+/*
+  ==============================================================================
+
+    Counter-based random numbers for the deterministic render mode.
+
+    Every draw is a pure function of (seed, position, note, channel, draw index),
+    so a note gets the same velocity whatever the block size, whether the host
+    renders offline or in real time, and in whatever order events are processed.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstdint>
+
+//==============================================================================
+class CounterRandom
+{
+public:
+    CounterRandom(std::uint64_t seed, std::int64_t position, int noteNumber, int channel) noexcept
+        : key(mix(seed + mix((std::uint64_t) position + mix(((std::uint64_t) noteNumber << 8) | (std::uint64_t) channel))))
+    {
+    }
+
+    // Same contract as juce::Random::nextInt(): 0 <= result < maxValue
+    int nextInt(int maxValue) noexcept
+    {
+        return (int) (((std::uint64_t) nextUint32() * (std::uint64_t) (maxValue > 0 ? maxValue : 0)) >> 32);
+    }
+
+    std::uint32_t nextUint32() noexcept
+    {
+        return (std::uint32_t) (mix(key + ++counter * 0x9e3779b97f4a7c15ull) >> 32);
+    }
+
+private:
+    // SplitMix64 finaliser, a full-avalanche 64 bit hash
+    static std::uint64_t mix(std::uint64_t z) noexcept
+    {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    std::uint64_t key;
+    std::uint64_t counter = 0;
+};
@@ -0,0 +1,123 @@
+/*
+  ==============================================================================
+
+    Peak/RMS envelope of the sidechain input, one value per sample of a block.
+
+    Rectifying and combining the channels runs through FloatVectorOperations,
+    so only the attack/release recursion is left as a scalar loop. Note-ons then
+    read the envelope at their own sample position.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+class EnvelopeFollower
+{
+public:
+    // Allocates, call from prepareToPlay
+    void prepare(double newSampleRate, int maximumBlockSize)
+    {
+        sampleRate = newSampleRate;
+        capacity = juce::jmax(1, maximumBlockSize);
+        envelope.allocate((size_t) capacity, true);
+        scratch.allocate((size_t) capacity, true);
+        numValid = 0;
+        state = 0.0f;
+    }
+
+    void setTimes(float attackMs, float releaseMs) noexcept
+    {
+        attackCoeff = getCoefficient(attackMs);
+        releaseCoeff = getCoefficient(releaseMs);
+    }
+
+    //==============================================================================
+    void process(const juce::AudioBuffer<float>& input, int numSamples, bool useRms) noexcept
+    {
+        // a host sending more than it promised in prepareToPlay only gets the first part followed
+        numValid = juce::jmin(numSamples, capacity);
+        rms = useRms;
+
+        auto* detector = envelope.get();
+        juce::FloatVectorOperations::clear(detector, numValid);
+
+        for (int ch = 0; ch < input.getNumChannels(); ++ch)
+        {
+            auto* samples = input.getReadPointer(ch);
+
+            if (rms)
+            {
+                juce::FloatVectorOperations::multiply(scratch.get(), samples, samples, numValid);
+                juce::FloatVectorOperations::add(detector, scratch.get(), numValid);
+            }
+            else
+            {
+                juce::FloatVectorOperations::abs(scratch.get(), samples, numValid);
+                juce::FloatVectorOperations::max(detector, detector, scratch.get(), numValid);
+            }
+        }
+
+        if (rms && input.getNumChannels() > 1)
+            juce::FloatVectorOperations::multiply(detector, 1.0f / (float) input.getNumChannels(), numValid);
+
+        // smoothed in place, RMS mode keeps the mean square until it is read
+        for (int i = 0; i < numValid; ++i)
+        {
+            const auto x = detector[i];
+            state = x + (x > state ? attackCoeff : releaseCoeff) * (state - x);
+            detector[i] = state;
+        }
+
+        if (state < 1.0e-12f)
+            state = 0.0f;   // don't let silence decay into denormals
+    }
+
+    // 0 at -48 dBFS and below, 1 at 0 dBFS
+    float getNormalisedLevel(int sample) const noexcept
+    {
+        if (numValid == 0)
+            return 0.0f;
+
+        auto level = envelope[juce::jlimit(0, numValid - 1, sample)];
+
+        if (rms)
+            level = std::sqrt(level);
+
+        return juce::jmap(juce::jlimit(-48.0f, 0.0f, juce::Decibels::gainToDecibels(level, -48.0f)), -48.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    //==============================================================================
+    // The smoothed envelope of the last block, raw (mean square in RMS mode), for capture
+    const float* getEnvelope() const noexcept       { return envelope.get(); }
+    int getNumSamples() const noexcept              { return numValid; }
+    bool isRms() const noexcept                     { return rms; }
+
+    // Replaces the last block's envelope with a captured one, instead of calling process()
+    void setEnvelope(const float* levels, int numSamples, bool useRms) noexcept
+    {
+        numValid = juce::jmin(numSamples, capacity);
+        rms = useRms;
+        juce::FloatVectorOperations::copy(envelope.get(), levels, numValid);
+    }
+
+    size_t getAllocatedBytes() const noexcept
+    {
+        return 2 * (size_t) capacity * sizeof(float);
+    }
+
+private:
+    float getCoefficient(float ms) const noexcept
+    {
+        return ms > 0.0f && sampleRate > 0.0 ? (float) std::exp(-1.0 / (ms * 0.001 * sampleRate)) : 0.0f;
+    }
+
+    juce::HeapBlock<float> envelope, scratch;
+    double sampleRate = 44100.0;
+    int capacity = 0, numValid = 0;
+    float state = 0.0f, attackCoeff = 0.0f, releaseCoeff = 0.0f;
+    bool rms = false;
+};
@@ -0,0 +1,219 @@
+/*
+  ==============================================================================
+
+    The velocities sent while FREEZE is on, keyed by where they happened.
+
+    Keys are (timeline position in 1/960 beats, note, channel), so when a loop
+    comes round again every note finds the velocity it had on the first pass
+    with one probe of an open-addressing table. The table is allocated off the
+    audio thread and never grows there: once it is three quarters full, new
+    notes are simply varied without being frozen.
+
+    The audio thread also posts every velocity it freezes to a FreezeJournal,
+    so the message thread can keep its own copy of the table for the plugin
+    state without ever locking the audio thread out of its lookups.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+class FreezeCache
+{
+public:
+    static constexpr double ticksPerQuarterNote = 960.0;
+
+    struct Entry
+    {
+        juce::int64 tick;
+        juce::uint8 note, channel, velocity, used;
+    };
+
+    // Allocates, never call from the audio thread. Keeps everything already cached.
+    void reserve(int minimumCapacity)
+    {
+        const auto newCapacity = juce::nextPowerOfTwo(juce::jmax(minimumCapacity, 64));
+
+        if (newCapacity <= capacity)
+            return;
+
+        juce::HeapBlock<Entry> old;
+        old.swapWith(entries);
+        const auto oldCapacity = capacity;
+
+        entries.calloc((size_t) newCapacity);
+        capacity = newCapacity;
+        numUsed = 0;
+
+        for (int i = 0; i < oldCapacity; ++i)
+            if (old[i].used)
+                insert(old[i].tick, old[i].note, old[i].channel, old[i].velocity);
+    }
+
+    //==============================================================================
+    static juce::int64 toTick(double ppqPosition) noexcept
+    {
+        return (juce::int64) std::llround(ppqPosition * ticksPerQuarterNote);
+    }
+
+    // The cached velocity, or 0 if this note hasn't been frozen yet
+    int find(juce::int64 tick, int note, int channel) const noexcept
+    {
+        if (capacity == 0)
+            return 0;
+
+        for (auto slot = getSlot(tick, note, channel);; slot = (slot + 1) & (capacity - 1))
+        {
+            const auto& e = entries[slot];
+
+            if (! e.used)
+                return 0;
+
+            if (e.tick == tick && e.note == note && e.channel == channel)
+                return e.velocity;
+        }
+    }
+
+    // Returns false, leaving the note unfrozen, once the table is three quarters full
+    bool insert(juce::int64 tick, int note, int channel, int velocity) noexcept
+    {
+        if (numUsed >= capacity - capacity / 4)
+            return false;
+
+        for (auto slot = getSlot(tick, note, channel);; slot = (slot + 1) & (capacity - 1))
+        {
+            auto& e = entries[slot];
+
+            if (! e.used)
+            {
+                e = { tick, (juce::uint8) note, (juce::uint8) channel, (juce::uint8) velocity, 1 };
+                ++numUsed;
+                return true;
+            }
+
+            if (e.tick == tick && e.note == note && e.channel == channel)
+            {
+                e.velocity = (juce::uint8) velocity;
+                return true;
+            }
+        }
+    }
+
+    int size() const noexcept           { return numUsed; }
+    int getCapacity() const noexcept    { return capacity; }
+
+    // The whole table as raw bytes, for captures
+    const Entry* getEntries() const noexcept    { return entries.get(); }
+
+    void setEntries(const Entry* source, int sourceCapacity)
+    {
+        entries.calloc((size_t) sourceCapacity);
+        capacity = sourceCapacity;
+        numUsed = 0;
+
+        for (int i = 0; i < capacity; ++i)
+            if ((entries[i] = source[i]).used)
+                ++numUsed;
+    }
+
+    //==============================================================================
+    // Only the used entries, for the plugin state
+    juce::String toBase64() const
+    {
+        juce::MemoryOutputStream out;
+
+        for (int i = 0; i < capacity; ++i)
+        {
+            if (entries[i].used)
+            {
+                out.writeInt64(entries[i].tick);
+                out.writeByte((char) entries[i].note);
+                out.writeByte((char) entries[i].channel);
+                out.writeByte((char) entries[i].velocity);
+            }
+        }
+
+        return out.getMemoryBlock().toBase64Encoding();
+    }
+
+    void fromBase64(const juce::String& text, int minimumCapacity)
+    {
+        juce::MemoryBlock data;
+        data.fromBase64Encoding(text);
+
+        constexpr int entrySize = 8 + 3;
+        const auto count = (int) data.getSize() / entrySize;
+
+        entries.free();
+        capacity = 0;
+        reserve(juce::jmax(minimumCapacity, count * 2));
+
+        juce::MemoryInputStream in(data, false);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const auto tick = in.readInt64();
+            const auto note = (juce::uint8) in.readByte();
+            const auto channel = (juce::uint8) in.readByte();
+            const auto velocity = (juce::uint8) in.readByte();
+            insert(tick, note, channel, velocity);
+        }
+    }
+
+private:
+    int getSlot(juce::int64 tick, int note, int channel) const noexcept
+    {
+        auto h = (juce::uint64) tick * 0x9e3779b97f4a7c15ull ^ ((juce::uint64) note << 8 | (juce::uint64) channel);
+        h = (h ^ (h >> 29)) * 0xbf58476d1ce4e5b9ull;
+        return (int) ((h ^ (h >> 32)) & (juce::uint64) (capacity - 1));
+    }
+
+    juce::HeapBlock<Entry> entries;
+    int capacity = 0, numUsed = 0;
+};
+
+//==============================================================================
+// The entries the audio thread adds to a FreezeCache, on their way to the message
+// thread. One writer and one reader; never allocates after construction.
+class FreezeJournal
+{
+public:
+    explicit FreezeJournal(int size) : fifo(size)
+    {
+        entries.calloc((size_t) size);
+    }
+
+    // Audio thread: check before a block freezes anything, so nothing is frozen that can't be posted
+    int getFreeSpace() const noexcept   { return fifo.getFreeSpace(); }
+
+    void post(const FreezeCache::Entry& entry) noexcept
+    {
+        const auto scope = fifo.write(1);
+
+        if (scope.blockSize1 > 0)
+            entries[scope.startIndex1] = entry;
+    }
+
+    // Reader thread: copies everything posted so far into a table
+    void drainInto(FreezeCache& table) noexcept
+    {
+        const auto scope = fifo.read(fifo.getNumReady());
+
+        scope.forEach([&] (int index)
+        {
+            const auto& e = entries[index];
+            table.insert(e.tick, e.note, e.channel, e.velocity);
+        });
+    }
+
+    size_t getAllocatedBytes() const noexcept   { return (size_t) fifo.getTotalSize() * sizeof(FreezeCache::Entry); }
+
+private:
+    juce::AbstractFifo fifo;
+    juce::HeapBlock<FreezeCache::Entry> entries;
+
+    JUCE_DECLARE_NON_COPYABLE(FreezeJournal)
+};
@@ -0,0 +1,85 @@
+/*
+  ==============================================================================
+
+    Platform code for GlobalControls: a POSIX shared memory object, or a named
+    file mapping on Windows. Kept out of the header so <windows.h> never meets
+    the JUCE headers.
+
+  ==============================================================================
+*/
+
+#include "GlobalControls.h"
+
+#include <string>
+
+#ifdef _WIN32
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#else
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+#endif
+
+//==============================================================================
+GlobalControls::GlobalControls(const char* name)
+{
+#ifdef _WIN32
+    const auto mappingName = std::string("Local\\") + name;
+    auto mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(Block), mappingName.c_str());
+
+    if (mapping == nullptr)
+        return;
+
+    if (auto* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Block)))
+    {
+        block = static_cast<Block*> (view);
+        platformHandle = mapping;
+    }
+    else
+    {
+        CloseHandle(mapping);
+    }
+#else
+    const auto objectName = std::string("/") + name;
+    const auto fd = shm_open(objectName.c_str(), O_RDWR | O_CREAT, 0600);
+
+    if (fd < 0)
+        return;
+
+    // macOS won't resize a shared memory object that already has a size, so only the first
+    // process to open it sizes it. If another gets in between our fstat and ftruncate, its
+    // ftruncate wins and ours fails, so look again before giving up.
+    auto isSized = [fd]
+    {
+        struct stat info;
+        return fstat(fd, &info) == 0 && info.st_size >= (off_t) sizeof(Block);
+    };
+
+    if (isSized() || ftruncate(fd, (off_t) sizeof(Block)) == 0 || isSized())
+    {
+        auto* view = mmap(nullptr, sizeof(Block), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if (view != MAP_FAILED)
+            block = static_cast<Block*> (view);
+    }
+
+    close(fd);
+#endif
+}
+
+GlobalControls::~GlobalControls()
+{
+    if (block == nullptr)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(block);
+    CloseHandle(static_cast<HANDLE> (platformHandle));
+#else
+    munmap(block, sizeof(Block));
+#endif
+}
@@ -0,0 +1,90 @@
+/*
+  ==============================================================================
+
+    A named shared-memory block of controls that every attached instance reads.
+
+    Large templates can move one humanize amount and seed across hundreds of
+    instances from a single controller process (see Tools/GlobalControl.cpp),
+    without automating each instance's parameters. All values are packed into
+    one lock-free 64 bit atomic, so a reader costs one atomic load per block
+    and a writer never blocks anyone.
+
+    Deliberately free of JUCE so the controller tool can build without it.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+//==============================================================================
+class GlobalControls
+{
+public:
+    struct Values
+    {
+        bool valid = false;           // false until a controller has written something
+        int amountPercent = 100;      // scales RANGE, 0..200
+        std::uint32_t seed = 0;       // replaces SEED in FIXED SEED mode
+    };
+
+    static constexpr const char* defaultName = "MIDIVelocityVariationGlobals";
+
+    // Opens (creating if needed) the named segment. Never call from the audio thread.
+    explicit GlobalControls(const char* name = defaultName);
+    ~GlobalControls();
+
+    bool isAttached() const noexcept        { return block != nullptr; }
+
+    // Wait-free, safe on the audio thread
+    Values read() const noexcept
+    {
+        return block != nullptr ? unpack(block->controls.load(std::memory_order_acquire)) : Values();
+    }
+
+    void write(const Values& values) noexcept
+    {
+        if (block != nullptr)
+            block->controls.store(pack(values), std::memory_order_release);
+    }
+
+    //==============================================================================
+    // bit 63 valid, bits 32..47 amount, bits 0..31 seed
+    static std::uint64_t pack(const Values& v) noexcept
+    {
+        const auto amount = (std::uint64_t) (v.amountPercent < 0 ? 0 : (v.amountPercent > 200 ? 200 : v.amountPercent));
+        return (v.valid ? (1ull << 63) : 0) | (amount << 32) | (std::uint64_t) v.seed;
+    }
+
+    static Values unpack(std::uint64_t bits) noexcept
+    {
+        Values v;
+        v.valid = (bits >> 63) != 0;
+
+        if (v.valid)
+        {
+            v.amountPercent = (int) ((bits >> 32) & 0xffff);
+            v.seed = (std::uint32_t) bits;
+        }
+
+        return v;
+    }
+
+private:
+    // a fresh segment is zero filled, which reads as "not valid"
+    struct Block
+    {
+        std::atomic<std::uint64_t> controls;
+    };
+
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+                  "the control block is shared between processes and must not hide a lock");
+
+    Block* block = nullptr;
+    void* platformHandle = nullptr;
+
+    GlobalControls(const GlobalControls&) = delete;
+    GlobalControls& operator=(const GlobalControls&) = delete;
+};
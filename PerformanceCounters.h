@@ -0,0 +1,145 @@
+/*
+  ==============================================================================
+
+    Lock-free processBlock instrumentation.
+
+    The audio thread is the only writer and uses relaxed atomics, so recording
+    a block costs a handful of plain stores. The editor and getPerformanceReport()
+    read a snapshot whose fields may be up to one block apart from each other,
+    which is fine for monitoring.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+class PerformanceCounters
+{
+public:
+    struct Snapshot
+    {
+        juce::int64 blocks = 0;
+        juce::int64 eventsIn = 0;
+        juce::int64 eventsOut = 0;
+        juce::int64 noteOnsModified = 0;
+        juce::int64 overruns = 0;
+
+        double minMs = 0.0;
+        double meanMs = 0.0;
+        double maxMs = 0.0;
+        double p99Ms = 0.0;
+
+        juce::String toString() const
+        {
+            juce::String s;
+            s << "blocks: " << blocks << "\n"
+              << "block time (ms): min " << juce::String(minMs, 4) << ", mean " << juce::String(meanMs, 4)
+              << ", max " << juce::String(maxMs, 4) << ", p99 " << juce::String(p99Ms, 4) << "\n"
+              << "events in: " << eventsIn << ", events out: " << eventsOut << "\n"
+              << "note-ons modified: " << noteOnsModified << "\n"
+              << "overruns: " << overruns << "\n";
+            return s;
+        }
+    };
+
+    //==============================================================================
+    // Not thread safe against addBlock(), call while the audio thread is stopped (prepareToPlay).
+    void reset() noexcept
+    {
+        blocks.store(0, std::memory_order_relaxed);
+        eventsIn.store(0, std::memory_order_relaxed);
+        eventsOut.store(0, std::memory_order_relaxed);
+        noteOnsModified.store(0, std::memory_order_relaxed);
+        overruns.store(0, std::memory_order_relaxed);
+        totalNs.store(0, std::memory_order_relaxed);
+        minNs.store(std::numeric_limits<juce::int64>::max(), std::memory_order_relaxed);
+        maxNs.store(0, std::memory_order_relaxed);
+
+        for (auto& b : histogram)
+            b.store(0, std::memory_order_relaxed);
+    }
+
+    // Audio thread only.
+    void addBlock(double elapsedSeconds, double budgetSeconds, int numEventsIn, int numEventsOut, int numNoteOnsModified) noexcept
+    {
+        const auto ns = (juce::int64) (elapsedSeconds * 1.0e9);
+
+        blocks.store(blocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        eventsIn.store(eventsIn.load(std::memory_order_relaxed) + numEventsIn, std::memory_order_relaxed);
+        eventsOut.store(eventsOut.load(std::memory_order_relaxed) + numEventsOut, std::memory_order_relaxed);
+        noteOnsModified.store(noteOnsModified.load(std::memory_order_relaxed) + numNoteOnsModified, std::memory_order_relaxed);
+        totalNs.store(totalNs.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+
+        if (ns < minNs.load(std::memory_order_relaxed))
+            minNs.store(ns, std::memory_order_relaxed);
+
+        if (ns > maxNs.load(std::memory_order_relaxed))
+            maxNs.store(ns, std::memory_order_relaxed);
+
+        if (budgetSeconds > 0.0 && elapsedSeconds > budgetSeconds)
+            overruns.store(overruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        auto& bucket = histogram[(size_t) getBucket(ns)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    //==============================================================================
+    Snapshot getSnapshot() const noexcept
+    {
+        Snapshot s;
+        s.blocks = blocks.load(std::memory_order_relaxed);
+        s.eventsIn = eventsIn.load(std::memory_order_relaxed);
+        s.eventsOut = eventsOut.load(std::memory_order_relaxed);
+        s.noteOnsModified = noteOnsModified.load(std::memory_order_relaxed);
+        s.overruns = overruns.load(std::memory_order_relaxed);
+
+        if (s.blocks == 0)
+            return s;
+
+        s.minMs = (double) minNs.load(std::memory_order_relaxed) * 1.0e-6;
+        s.maxMs = (double) maxNs.load(std::memory_order_relaxed) * 1.0e-6;
+        s.meanMs = (double) totalNs.load(std::memory_order_relaxed) * 1.0e-6 / (double) s.blocks;
+
+        // walk down from the slowest bucket until 1% of the blocks have been passed
+        juce::int64 counted = 0, onePercent = juce::jmax((juce::int64) 1, s.blocks / 100);
+
+        for (int i = numBuckets; --i >= 0;)
+        {
+            counted += histogram[(size_t) i].load(std::memory_order_relaxed);
+
+            if (counted >= onePercent)
+            {
+                s.p99Ms = juce::jmin(s.maxMs, (double) getBucketUpperBound(i) * 1.0e-6);
+                break;
+            }
+        }
+
+        return s;
+    }
+
+private:
+    //==============================================================================
+    // four buckets per octave of nanoseconds, up to ~4.3 seconds
+    static constexpr int numBuckets = 32 * 4;
+
+    static int getBucket(juce::int64 ns) noexcept
+    {
+        const auto v = (juce::uint32) juce::jlimit((juce::int64) 4, (juce::int64) 0xffffffff, ns);
+        const auto octave = juce::findHighestSetBit(v);
+        return octave * 4 + (int) ((v >> (octave - 2)) & 3);
+    }
+
+    static juce::int64 getBucketUpperBound(int bucket) noexcept
+    {
+        const auto octave = bucket / 4;
+        const auto step = bucket % 4;
+        return ((juce::int64) (4 + step + 1)) << (octave - 2);
+    }
+
+    std::atomic<juce::int64> blocks { 0 }, eventsIn { 0 }, eventsOut { 0 }, noteOnsModified { 0 }, overruns { 0 };
+    std::atomic<juce::int64> totalNs { 0 }, minNs { std::numeric_limits<juce::int64>::max() }, maxNs { 0 };
+    std::array<std::atomic<juce::int64>, (size_t) numBuckets> histogram {};
+};
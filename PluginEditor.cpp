@@ -10,10 +10,40 @@
 #include "PluginEditor.h"
 
 
+//=======================================================================================
+class ParameterListener;
+
+// One timer for every parameter component in the process. Each component used to run
+// its own timer, so a session with many editors open had thousands of them firing and
+// re-sorting JUCE's timer list; now a tick is one pass over a flat list of flags.
+class ParameterRefreshTimer : private juce::Timer
+{
+public:
+    void add(ParameterListener* l)
+    {
+        listeners.add(l);
+
+        if (! isTimerRunning())
+            startTimerHz(30);
+    }
+
+    void remove(ParameterListener* l)
+    {
+        listeners.removeFirstMatchingValue(l);
+
+        if (listeners.isEmpty())
+            stopTimer();
+    }
+
+private:
+    void timerCallback() override;
+
+    juce::Array<ParameterListener*> listeners;
+};
+
 //=======================================================================================
 class ParameterListener : private juce::AudioProcessorParameter::Listener,
-    private juce::AudioProcessorListener,
-    private juce::Timer
+    private juce::AudioProcessorListener
 {
 public:
     ParameterListener(juce::AudioProcessor& proc, juce::AudioProcessorParameter& param)
@@ -22,11 +52,12 @@ public:
 
         parameter.addListener(this);
 
-        startTimer(100);
+        refreshTimer->add(this);
     }
 
     ~ParameterListener() override
     {
+        refreshTimer->remove(this);
         parameter.removeListener(this);
     }
 
@@ -37,6 +68,13 @@ public:
 
     virtual void handleNewParameterValue() = 0;
 
+    // Called by the shared refresh timer
+    void refreshIfChanged()
+    {
+        if (parameterValueHasChanged.compareAndSetBool(0, 1))
+            handleNewParameterValue();
+    }
+
 private:
     //==============================================================================
     void parameterValueChanged(int, float) override
@@ -55,28 +93,24 @@ private:
 
     void audioProcessorChanged(juce::AudioProcessor*, const ChangeDetails&) override {}
 
-    //==============================================================================
-    void timerCallback() override
-    {
-        if (parameterValueHasChanged.compareAndSetBool(0, 1))
-        {
-            handleNewParameterValue();
-            startTimerHz(50);
-        }
-        else
-        {
-            startTimer(juce::jmin(250, getTimerInterval() + 10));
-        }
-    }
-
     juce::AudioProcessor& processor;
     juce::AudioProcessorParameter& parameter;
     juce::Atomic<int> parameterValueHasChanged{ 0 };
+    juce::SharedResourcePointer<ParameterRefreshTimer> refreshTimer;
    
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParameterListener)
 };
 
+void ParameterRefreshTimer::timerCallback()
+{
+    TRACE_SCOPE("ParameterRefreshTimer::timerCallback");
+
+    // by index, a refresh can rebuild components and change the list
+    for (int i = 0; i < listeners.size(); ++i)
+        listeners.getUnchecked(i)->refreshIfChanged();
+}
+
 //============================================================================================================
 class SliderParameterComponent final : public juce::Component,
     private ParameterListener
@@ -914,10 +948,9 @@ public:
             if (param->isAutomatable())
                 addChildAndSetID(paramComponents.add(new ParameterDisplayComponent(processor, *param, paramWidth)), param->getName(128) + "Comp");
 
-        //allComponents.addArray(paramComponents);   this line causes exception error... idk why but it's not being deleted properly
-        for (auto* param : parameters)    // have to do the loop again as a fix... still looking for a cleaner solution 
-            if (param->isAutomatable())
-                allComponents.add(new ParameterDisplayComponent(processor, *param, paramWidth));
+        // allComponents only points at children, paramComponents and subPanels own them
+        for (auto* comp : paramComponents)
+            allComponents.add(comp);
 
         maxWidth = 400;
         height = 0;
@@ -940,16 +973,20 @@ public:
     ~ParametersPanel() override
     {
         allComponents.clear();
+        subPanels.clear();
         paramComponents.clear();
     }
   
     void addParameterDisplayComponent(ParameterDisplayComponent* comp, juce::String ID)
     {
         addChildAndSetID(paramComponents.add(comp), ID);
+        allComponents.add(comp);
     }
 
     void paint(juce::Graphics& g) override
     {
+        TRACE_SCOPE("ParametersPanel::paint");
+
         g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
         
         if (outline)
@@ -991,6 +1028,7 @@ public:
 
     void addPanel(ParametersPanel* p)
     {
+        subPanels.add(p);
         allComponents.add(p);
         addAndMakeVisible(p);
         setSize(maxWidth, getHeight() + p->getHeight());
@@ -1004,13 +1042,195 @@ public:
     int paramWidth = 400;
     int paramHeight = 40;
     juce::OwnedArray<ParameterDisplayComponent> paramComponents;
-    juce::OwnedArray<Component> allComponents;
+    juce::OwnedArray<ParametersPanel> subPanels;
+    juce::Array<Component*> allComponents;
 
 private:
     bool horizontal, outline;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParametersPanel)
 };
 
+//==============================================================================
+class PerformanceDisplayComponent final : public juce::Component,   // one line of processBlock stats
+    private juce::Timer
+{
+public:
+    PerformanceDisplayComponent(NewProjectAudioProcessor& p)
+        : processor(p)
+    {
+        label.setColour(juce::Label::textColourId, juce::Colours::grey);
+        label.setFont(juce::Font(12.0f));
+        label.setJustificationType(juce::Justification::centredLeft);
+        addAndMakeVisible(label);
+
+        captureButton.setClickingTogglesState(true);
+        captureButton.setToggleState(processor.isCapturing(), juce::dontSendNotification);
+        captureButton.setTooltip("Record the incoming MIDI and settings to a file in Documents/MIDI Velocity Variation, "
+                                 "so the session can be replayed exactly later");
+        captureButton.onClick = [this] { toggleCapture(); };
+        addAndMakeVisible(captureButton);
+
+        timerCallback();
+        startTimerHz(4);
+    }
+
+    void paint(juce::Graphics&) override {}
+
+    void resized() override
+    {
+        auto area = getLocalBounds().reduced(10, 0);
+        captureButton.setBounds(area.removeFromRight(40).reduced(0, 2));
+        label.setBounds(area);
+    }
+
+private:
+    void timerCallback() override
+    {
+        auto stats = processor.getPerformanceCounters().getSnapshot();
+
+        label.setText(juce::String::formatted("block %.3f ms avg, %.3f max, %.3f p99   overruns %d",
+                                              stats.meanMs, stats.maxMs, stats.p99Ms, (int) stats.overruns),
+                      juce::dontSendNotification);
+        label.setTooltip(stats.toString());
+    }
+
+    void toggleCapture()
+    {
+        if (! captureButton.getToggleState())
+        {
+            processor.stopCapture();
+            return;
+        }
+
+        auto folder = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("MIDI Velocity Variation");
+        folder.createDirectory();
+
+        const auto file = folder.getChildFile("capture-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S") + ".mvvcap");
+
+        if (! processor.startCapture(file))
+            captureButton.setToggleState(false, juce::dontSendNotification);
+    }
+
+    NewProjectAudioProcessor& processor;
+    juce::Label label;
+    juce::TextButton captureButton { "REC" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PerformanceDisplayComponent)
+};
+
+//==============================================================================
+class VelocityCurveComponent final : public juce::Component,       // drag the points to draw the input curve
+    private juce::ChangeListener
+{
+public:
+    VelocityCurveComponent(NewProjectAudioProcessor& p)
+        : processor(p), curve(p.getCurve())
+    {
+        shapes.addItemList(VelocityCurve::getShapeNames(), 1);
+        shapes.setTextWhenNothingSelected("CURVE");
+        shapes.setTooltip("Shapes incoming velocities before they are varied. Drag the points to draw your own");
+        shapes.onChange = [this] { shapeChanged(); };
+        addAndMakeVisible(shapes);
+
+        processor.addCurveListener(this);
+    }
+
+    ~VelocityCurveComponent() override
+    {
+        processor.removeCurveListener(this);
+    }
+
+    void paint(juce::Graphics& g) override
+    {
+        TRACE_SCOPE("VelocityCurveComponent::paint");
+
+        auto area = getCurveArea();
+
+        g.setColour(juce::Colours::darkgrey.withAlpha(0.5f));
+        g.fillRect(area);
+        g.drawLine(area.getX(), area.getBottom(), area.getRight(), area.getY());
+
+        juce::Path path;
+
+        for (int i = 0; i < VelocityCurve::numPoints; ++i)
+        {
+            auto point = getPointPosition(i);
+
+            if (i == 0)
+                path.startNewSubPath(point);
+            else
+                path.lineTo(point);
+        }
+
+        g.setColour(findColour(juce::Slider::trackColourId));
+        g.strokePath(path, juce::PathStrokeType(2.0f));
+
+        g.setColour(findColour(juce::Slider::thumbColourId));
+
+        for (int i = 0; i < VelocityCurve::numPoints; ++i)
+            g.fillEllipse(juce::Rectangle<float>(7.0f, 7.0f).withCentre(getPointPosition(i)));
+    }
+
+    void resized() override
+    {
+        auto area = getLocalBounds().reduced(0, 8);
+        shapes.setBounds(area.removeFromRight(100).removeFromTop(24));
+    }
+
+    void mouseDown(const juce::MouseEvent& e) override
+    {
+        auto area = getCurveArea();
+        dragIndex = juce::roundToInt((e.position.x - area.getX()) / area.getWidth() * (VelocityCurve::numPoints - 1));
+        dragIndex = juce::jlimit(0, VelocityCurve::numPoints - 1, dragIndex);
+        mouseDrag(e);
+    }
+
+    void mouseDrag(const juce::MouseEvent& e) override
+    {
+        auto area = getCurveArea();
+        curve.setPoint(dragIndex, (area.getBottom() - e.position.y) / area.getHeight());
+        shapes.setSelectedItemIndex(-1, juce::dontSendNotification);
+        processor.setCurve(curve);
+        repaint();
+    }
+
+private:
+    void changeListenerCallback(juce::ChangeBroadcaster*) override
+    {
+        curve = processor.getCurve();
+        repaint();
+    }
+
+    void shapeChanged()
+    {
+        if (shapes.getSelectedItemIndex() < 0)
+            return;
+
+        curve.setShape((VelocityCurve::Shape) shapes.getSelectedItemIndex());
+        processor.setCurve(curve);
+        repaint();
+    }
+
+    juce::Rectangle<float> getCurveArea() const
+    {
+        return getLocalBounds().reduced(10, 8).withTrimmedRight(110).toFloat();
+    }
+
+    juce::Point<float> getPointPosition(int index) const
+    {
+        auto area = getCurveArea();
+        return { area.getX() + area.getWidth() * (float) index / (float) (VelocityCurve::numPoints - 1),
+                 area.getBottom() - area.getHeight() * curve.getPoint(index) };
+    }
+
+    NewProjectAudioProcessor& processor;
+    VelocityCurve curve;
+    juce::ComboBox shapes;
+    int dragIndex = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VelocityCurveComponent)
+};
+
 //==============================================================================>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
 
@@ -1032,7 +1252,8 @@ struct AarrowAudioProcessorEditor::Pimpl
 
 
 
-        ParametersPanel* myPanel = new ParametersPanel(owner.audioProcessor, params, false);
+        mainPanel.reset(new ParametersPanel(owner.audioProcessor, params, false));
+        auto* myPanel = mainPanel.get();
 
         //myPanel->setSize(400, 100);
         dynamic_cast<ParameterDisplayComponent*> (myPanel->findChildWithID("-RANGEComp"))->displayParameterName(juce::Justification::centredRight);
@@ -1067,14 +1288,139 @@ struct AarrowAudioProcessorEditor::Pimpl
         BaseSlider->changeSliderStyle(3);
         BaseButton->setLink(*BaseSlider);
         BaseSlider->linkAction(false);
-      
+
+        params.clear();
+        params.add(owner.audioProcessor.adaptive);
+        ParametersPanel* AdaptivePanel = new ParametersPanel(owner.audioProcessor, params, true);
+        AdaptivePanel->paramWidth = 200;
+        myPanel->addPanel(AdaptivePanel);
+
+        //// -----------------------------------------------------------------------------------
+        params.clear();
+        params.add(owner.audioProcessor.antiRepeat);
+        params.add(owner.audioProcessor.deterministic);
+        params.add(owner.audioProcessor.seed);
+        params.add(owner.audioProcessor.useGlobalControls);
+        ParametersPanel* OptionsPanel = new ParametersPanel(owner.audioProcessor, params, true);
+        myPanel->addPanel(OptionsPanel);
+        auto SeedSlider = dynamic_cast<SliderParameterComponent*>(OptionsPanel->findChildWithID("-SEEDComp")->findChildWithID("ActualComponent"));
+        SeedSlider->changeSliderStyle(3);
+        SeedSlider->setSliderTooltip("Seed for FIXED SEED mode. The same seed always gives the same velocities for the same notes, whatever the buffer size or render mode");
+
+        //// -----------------------------------------------------------------------------------
+        params.clear();
+        params.add(owner.audioProcessor.chords);
+        params.add(owner.audioProcessor.chordWindow);
+        params.add(owner.audioProcessor.chordSpread);
+        ParametersPanel* ChordPanel = new ParametersPanel(owner.audioProcessor, params, true);
+        myPanel->addPanel(ChordPanel);
+        auto WindowSlider = dynamic_cast<SliderParameterComponent*>(ChordPanel->findChildWithID("-WINDOWComp")->findChildWithID("ActualComponent"));
+        WindowSlider->changeSliderStyle(3);
+        WindowSlider->setSliderTooltip("Note-ons starting within this many milliseconds of each other are treated as one chord and share a single variation");
+        auto SpreadSlider = dynamic_cast<SliderParameterComponent*>(ChordPanel->findChildWithID("-SPREADComp")->findChildWithID("ActualComponent"));
+        SpreadSlider->changeSliderStyle(3);
+        SpreadSlider->setSliderTooltip("How far each note of a chord may move away from the chord's shared variation");
+
+        //// -----------------------------------------------------------------------------------
+        params.clear();
+        params.add(owner.audioProcessor.repetitionAmount);
+        ParametersPanel* RepeatsPanel = new ParametersPanel(owner.audioProcessor, params, true);
+        myPanel->addPanel(RepeatsPanel);
+        dynamic_cast<ParameterDisplayComponent*> (RepeatsPanel->findChildWithID("-FAST REPEATSComp"))->displayParameterName(juce::Justification::centredRight);
+        auto RepeatsSlider = dynamic_cast<SliderParameterComponent*>(RepeatsPanel->findChildWithID("-FAST REPEATSComp")->findChildWithID("ActualComponent"));
+        RepeatsSlider->changeSliderStyle(3);
+        RepeatsSlider->setSliderTooltip("Notes repeated faster than a quarter second lose accent and vary more, like a player at speed");
+
+        //// -----------------------------------------------------------------------------------
+        params.clear();
+        params.add(owner.audioProcessor.freeze);
+        ParametersPanel* FreezePanel = new ParametersPanel(owner.audioProcessor, params, true);
+        FreezePanel->paramWidth = 200;      // the other half is the re-roll button
+        myPanel->addPanel(FreezePanel);
+
+        rerollButton.setTooltip("While FREEZE is on, each note keeps the velocity it got on the first pass of the loop. Re-roll forgets them all, and so does switching FREEZE off");
+        rerollButton.onClick = [this] { owner.audioProcessor.rerollFreeze(); };
+        FreezePanel->addAndMakeVisible(rerollButton);
+        FreezePanel->resized();
+        rerollButton.setBounds(FreezePanel->getLocalBounds().removeFromRight(200).reduced(10, 8));
+
+#if ! JucePlugin_IsMidiEffect
+        //// -----------------------------------------------------------------------------------
+        params.clear();
+        params.add(owner.audioProcessor.sidechainAmount);
+        params.add(owner.audioProcessor.sidechainDetector);
+        ParametersPanel* SidechainPanel = new ParametersPanel(owner.audioProcessor, params, true);
+        myPanel->addPanel(SidechainPanel);
+        auto SidechainSlider = dynamic_cast<SliderParameterComponent*>(SidechainPanel->findChildWithID("-SIDECHAINComp")->findChildWithID("ActualComponent"));
+        SidechainSlider->changeSliderStyle(3);
+        SidechainSlider->setSliderTooltip("How much the level of the sidechain input pushes velocities up (loud) or down (quiet)");
+
+        params.clear();
+        params.add(owner.audioProcessor.sidechainAttack);
+        params.add(owner.audioProcessor.sidechainRelease);
+        ParametersPanel* EnvelopePanel = new ParametersPanel(owner.audioProcessor, params, true);
+        myPanel->addPanel(EnvelopePanel);
+
+        for (auto* id : { "-ATTACKComp", "-RELEASEComp" })
+        {
+            auto EnvelopeSlider = dynamic_cast<SliderParameterComponent*>(EnvelopePanel->findChildWithID(id)->findChildWithID("ActualComponent"));
+            EnvelopeSlider->changeSliderStyle(3);
+            EnvelopeSlider->setSliderTooltip("Sidechain envelope attack / release in milliseconds");
+        }
+#endif
+
+        //// -----------------------------------------------------------------------------------
+        for (int i = 0; i < NewProjectAudioProcessor::numExtraLanes; ++i)
+        {
+            auto& lane = owner.audioProcessor.lanes[(size_t) i];
+            const auto name = "-L" + juce::String(i + 2) + " ";
+
+            params.clear();
+            params.add(lane.channel);
+            params.add(lane.range);
+            params.add(lane.skew);
+            params.add(lane.direction);
+            ParametersPanel* LanePanel = new ParametersPanel(owner.audioProcessor, params, true);
+            myPanel->addPanel(LanePanel);
+
+            auto ChannelSlider = dynamic_cast<SliderParameterComponent*>(LanePanel->findChildWithID(name + "CHANNELComp")->findChildWithID("ActualComponent"));
+            ChannelSlider->changeSliderStyle(3);
+            ChannelSlider->setSliderTooltip("Notes on this MIDI channel use this lane's settings and come out on the same channel. 0 turns the lane off");
+
+            for (auto id : { name + "RANGEComp", name + "INTENSITYComp" })
+            {
+                auto LaneSlider = dynamic_cast<SliderParameterComponent*>(LanePanel->findChildWithID(id)->findChildWithID("ActualComponent"));
+                LaneSlider->changeSliderStyle(3);
+            }
+        }
+
+        //// -----------------------------------------------------------------------------------
+        for (int i = 0; i < NewProjectAudioProcessor::maxDoubles; ++i)
+        {
+            auto& target = owner.audioProcessor.doubles[(size_t) i];
+            const auto name = "-D" + juce::String(i + 1) + " ";
+
+            params.clear();
+            params.add(target.channel);
+            params.add(target.range);
+            ParametersPanel* DoublePanel = new ParametersPanel(owner.audioProcessor, params, true);
+            myPanel->addPanel(DoublePanel);
+
+            auto ChannelSlider = dynamic_cast<SliderParameterComponent*>(DoublePanel->findChildWithID(name + "CHANNELComp")->findChildWithID("ActualComponent"));
+            ChannelSlider->changeSliderStyle(3);
+            ChannelSlider->setSliderTooltip("Also send every note to this MIDI channel, with its own variation. 0 turns the double off");
+
+            auto DoubleRangeSlider = dynamic_cast<SliderParameterComponent*>(DoublePanel->findChildWithID(name + "RANGEComp")->findChildWithID("ActualComponent"));
+            DoubleRangeSlider->changeSliderStyle(3);
+        }
+
         //// -----------------------------------------------------------------------------------
  
 
-                // 2 SliderParameterComponent leaks disappear when panel4 is added to myPanel instead...
         params.clear();
         params.add(owner.audioProcessor.skew);
-        ParametersPanel* Panel4 = new ParametersPanel(owner.audioProcessor, params, true);     
+        intensityPanel.reset(new ParametersPanel(owner.audioProcessor, params, true));
+        auto* Panel4 = intensityPanel.get();
         //Panel4->findChildWithID("-skewComp")->setSize(100, 120);
         auto SkewSlider = dynamic_cast<SliderParameterComponent*>(Panel4->findChildWithID("-INTENSITYComp")->findChildWithID("ActualComponent"));
         dynamic_cast<ParameterDisplayComponent*> (Panel4->findChildWithID("-INTENSITYComp"))->displayParameterName(juce::Justification::bottomLeft);
@@ -1089,11 +1435,21 @@ struct AarrowAudioProcessorEditor::Pimpl
      
      
         // ---------------------------------------------------------------------------------------------
-        fullPanel = new juce::Component();
+        fullPanel.reset(new juce::Component());
         fullPanel->setSize(500, myPanel->getHeight());
         fullPanel->addAndMakeVisible(myPanel);
         fullPanel->addAndMakeVisible(Panel4);
         Panel4->setBounds(fullPanel->getLocalBounds().removeFromRight(100));
+
+        curveEditor.reset(new VelocityCurveComponent(owner.audioProcessor));
+        fullPanel->setSize(fullPanel->getWidth(), fullPanel->getHeight() + 120);
+        fullPanel->addAndMakeVisible(*curveEditor);
+        curveEditor->setBounds(fullPanel->getLocalBounds().removeFromBottom(120).withWidth(400));
+
+        performanceDisplay.reset(new PerformanceDisplayComponent(owner.audioProcessor));
+        fullPanel->setSize(fullPanel->getWidth(), fullPanel->getHeight() + 20);
+        fullPanel->addAndMakeVisible(*performanceDisplay);
+        performanceDisplay->setBounds(fullPanel->getLocalBounds().removeFromBottom(20));
        
         
         
@@ -1107,7 +1463,7 @@ struct AarrowAudioProcessorEditor::Pimpl
         //SyncComp->getParameterComp<BooleanButtonParameterComponent>()->setLink(*SpeedComp->findChildWithID("ActualComponent"));
 
         params.clear();
-        view.setViewedComponent(fullPanel);
+        view.setViewedComponent(fullPanel.get(), false);
         //view.setViewedComponent(myPanel);
         owner.addAndMakeVisible(view);
         owner.addAndMakeVisible(tooltipWindow);
@@ -1130,7 +1486,11 @@ struct AarrowAudioProcessorEditor::Pimpl
 
     //==============================================================================
     AarrowAudioProcessorEditor& owner;
-    juce::Component* fullPanel;
+    std::unique_ptr<ParametersPanel> mainPanel, intensityPanel;
+    std::unique_ptr<VelocityCurveComponent> curveEditor;
+    std::unique_ptr<PerformanceDisplayComponent> performanceDisplay;
+    std::unique_ptr<juce::Component> fullPanel;
+    juce::TextButton rerollButton { "RE-ROLL" };
     juce::Array<juce::AudioProcessorParameter*> params;
     juce::Viewport view;
 private : 
@@ -1150,7 +1510,7 @@ AarrowAudioProcessorEditor::AarrowAudioProcessorEditor(NewProjectAudioProcessor&
 
     //AarrowLookAndFeel* Aalf = new AarrowLookAndFeel();
     
-    setLookAndFeel(&Aalf);
+    setLookAndFeel(&Aalf.getObject());
     setSize(pimpl->view.getViewedComponent()->getWidth() + pimpl->view.getVerticalScrollBar().getWidth(),
         juce::jmin(pimpl->view.getViewedComponent()->getHeight(), 400));
 
@@ -1166,6 +1526,8 @@ AarrowAudioProcessorEditor::~AarrowAudioProcessorEditor()
 //==============================================================================
 void AarrowAudioProcessorEditor::paint(juce::Graphics& g)
 {
+    TRACE_SCOPE("AarrowAudioProcessorEditor::paint");
+
     // (Our component is opaque, so we must completely fill the background with a solid colour)
     g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
 
@@ -1181,6 +1543,62 @@ void AarrowAudioProcessorEditor::resized()
     pimpl->resize(getLocalBounds());
 }
 
+//==============================================================================
+template <typename ComponentType>
+static bool addComponentIfType(const juce::Component& c, MemoryFootprint& footprint, const juce::String& subsystem)
+{
+    if (dynamic_cast<const ComponentType*> (&c) == nullptr)
+        return false;
+
+    footprint.add(subsystem, sizeof(ComponentType));
+    return true;
+}
+
+static void addComponentTree(const juce::Component& c, MemoryFootprint& footprint)
+{
+    // a parameter component owns no timer, only an entry in the shared ParameterRefreshTimer's
+    // list; the performance display is the one component that still runs its own
+    const bool isParameterComponent = addComponentIfType<SliderParameterComponent>(c, footprint, "parameter components")
+        || addComponentIfType<BooleanButtonParameterComponent>(c, footprint, "parameter components")
+        || addComponentIfType<BooleanParameterComponent>(c, footprint, "parameter components")
+        || addComponentIfType<SwitchButtonParameterComponent>(c, footprint, "parameter components")
+        || addComponentIfType<SwitchParameterComponent>(c, footprint, "parameter components")
+        || addComponentIfType<IncrementParameterComponent>(c, footprint, "parameter components")
+        || addComponentIfType<ChoiceParameterComponent>(c, footprint, "parameter components");
+
+    if (isParameterComponent)
+        footprint.add("shared refresh timer entries", sizeof(ParameterListener*));
+    else if (addComponentIfType<PerformanceDisplayComponent>(c, footprint, "performance display"))
+        footprint.add("timers", 0);
+    else if (! (addComponentIfType<ParametersPanel>(c, footprint, "panels")
+                || addComponentIfType<ParameterDisplayComponent>(c, footprint, "panels")
+                || addComponentIfType<VelocityCurveComponent>(c, footprint, "curve editor")
+                || addComponentIfType<juce::Label>(c, footprint, "labels")
+                || addComponentIfType<juce::TextButton>(c, footprint, "buttons")
+                || addComponentIfType<juce::ToggleButton>(c, footprint, "buttons")
+                || addComponentIfType<juce::Slider>(c, footprint, "sliders")
+                || addComponentIfType<juce::ComboBox>(c, footprint, "sliders")
+                || addComponentIfType<juce::Viewport>(c, footprint, "viewport")
+                || addComponentIfType<juce::ScrollBar>(c, footprint, "viewport")
+                || addComponentIfType<juce::TooltipWindow>(c, footprint, "tooltips")))
+        footprint.add("other components", sizeof(juce::Component));
+
+    for (auto* child : c.getChildren())
+        addComponentTree(*child, footprint);
+}
+
+MemoryFootprint AarrowAudioProcessorEditor::getMemoryFootprint() const
+{
+    MemoryFootprint footprint;
+
+    footprint.add("editor", sizeof(*this) + sizeof(Pimpl));
+
+    for (auto* child : getChildren())
+        addComponentTree(*child, footprint);
+
+    return footprint;
+}
+
 //===================================================================================
 
 
@@ -107,7 +107,7 @@ public:
             shadowArea.translate(0, edge);
 
             // shadow
-            g.setColour(juce::Colours::darkgrey.withAlpha(0.5f));
+            g.setColour(shadowColour);
             g.fillRect(shadowArea.withTrimmedRight(edge*4));
 
 
@@ -117,10 +117,9 @@ public:
             x += edge;
             y -= edge;
 
-            std::unique_ptr<ColourGradient> gradient(new ColourGradient(juce::Colours::white, static_cast<float> (x), (float)y + 0.5f, slider.findColour(Slider::trackColourId), sliderPos - (float)x, (float)height - 1.0f, true));
+            ColourGradient gradient(juce::Colours::white, static_cast<float> (x), (float)y + 0.5f, slider.findColour(Slider::trackColourId), sliderPos - (float)x, (float)height - 1.0f, true);
             //gradient->addColour(0.5f, juce::Colours::grey);
-            std::unique_ptr<FillType> phil(new FillType(*gradient));                
-            g.setFillType(*phil);
+            g.setGradientFill(gradient);
 
             g.fillRect(slider.isHorizontal() ? Rectangle<float>(static_cast<float> (x), (float)y + 0.5f, juce::jmax(5.0f-(float)x ,sliderPos - (float)x), (float)height - 1.0f)
                 : Rectangle<float>((float)x + 0.5f, (float)y-sliderPos, (float)width - 1.0f, (float)y + ((float)height - sliderPos)));
@@ -132,26 +131,25 @@ public:
 
            //outline
            // g.setColour(juce::Colours::grey);
-            auto area = new Rectangle<float>((float)x, (float)y, width, height);
-           //g.fillRect(*area);
+            auto area = Rectangle<float>((float)x, (float)y, (float)width, (float)height);
+           //g.fillRect(area);
 
             g.setColour(findColour(PropertyComponent::backgroundColourId));
-            g.fillRect(area->reduced(1));
+            g.fillRect(area.reduced(1));
             
 
-            *area = area->reduced(6);
-            x = area->getTopLeft().getX();
-            width = area->getWidth();
-            y = area->getTopLeft().getY();  // commenting this line makes a battery shape* 
-            height = area->getHeight();
+            area = area.reduced(6);
+            x = (int)area.getTopLeft().getX();
+            width = (int)area.getWidth();
+            y = (int)area.getTopLeft().getY();  // commenting this line makes a battery shape* 
+            height = (int)area.getHeight();
 
             sliderPos += 7; //sliderPos would reach the top of the background rectangle otherwise
                             //slider.proportionOfLengthToValue
                             // 
-            std::unique_ptr<ColourGradient> gradient(new ColourGradient(slider.findColour(Slider::thumbColourId), static_cast<float> (x), (float)y + 0.5f, slider.findColour(Slider::trackColourId), static_cast<float> (x), (float)height - 1.0f, false));
-            std::unique_ptr<FillType> phil(new FillType(*gradient));            //gradient = new ColourGradient(slider.findColour(Slider::thumbColourId) , static_cast<float> (x), (float)y + 0.5f, slider.findColour(Slider::trackColourId), static_cast<float> (x), (float)height - 1.0f, false);
+            ColourGradient gradient(slider.findColour(Slider::thumbColourId), static_cast<float> (x), (float)y + 0.5f, slider.findColour(Slider::trackColourId), static_cast<float> (x), (float)height - 1.0f, false);
             //gradient->addColour(0.5f, juce::Colours::grey);
-            g.setFillType(*phil);
+            g.setGradientFill(gradient);
             //g.setFillType(*(new FillType(*gradient)));
             //g.setColour(findColour(Slider::trackColourId));
 
@@ -185,7 +183,7 @@ public:
         buttonArea.removeFromTop(edge);
 
         // shadow
-        g.setColour(juce::Colours::darkgrey.withAlpha(0.5f));
+        g.setColour(shadowColour);
         g.fillRect(buttonArea);
 
         auto offset = isButtonDown ? -edge / 2 : -edge;
@@ -198,6 +196,8 @@ public:
 
 
 private:
+    const juce::Colour shadowColour = juce::Colours::darkgrey.withAlpha(0.5f);
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AarrowLookAndFeel)
 };
 
@@ -212,6 +212,10 @@ public:
     void paint(juce::Graphics&) override;
     void resized() override;
 
+    // Bytes held by this editor and its component tree, split by subsystem.
+    // The shared LookAndFeel is not counted.
+    MemoryFootprint getMemoryFootprint() const;
+
     // This constructor has been changed to take a reference instead of a pointer
     //JUCE_DEPRECATED_WITH_BODY(AarrowAudioProcessorEditor(juce::AudioProcessor* p), : AarrowAudioProcessorEditor(*p) {})
 private:
@@ -220,7 +224,9 @@ private:
     NewProjectAudioProcessor& audioProcessor;
     struct Pimpl;
     std::unique_ptr<Pimpl> pimpl;
-    AarrowLookAndFeel Aalf;
+
+    // one LookAndFeel (colours, typeface, drawing code) for every open editor in the process
+    juce::SharedResourcePointer<AarrowLookAndFeel> Aalf;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AarrowAudioProcessorEditor)
 };
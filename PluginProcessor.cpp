@@ -18,6 +18,7 @@ NewProjectAudioProcessor::NewProjectAudioProcessor()
         .withInput("Input", juce::AudioChannelSet::stereo(), true)
 #endif
         .withOutput("Output", juce::AudioChannelSet::stereo(), true)
+        .withInput("Sidechain", juce::AudioChannelSet::stereo(), false)
 #endif
     )
 #endif
@@ -28,14 +29,106 @@ NewProjectAudioProcessor::NewProjectAudioProcessor()
     addParameter(baseValue = new juce::AudioParameterInt("baseValue", "-", 0,127,84));
 
 
-    addParameter(base = new juce::AudioParameterChoice("base", "bBase", {"AUTO","BASE VALUE :"}, 0));
-    addParameter(direction = new juce::AudioParameterChoice("direction", "-Direction", {"Up","Centred","Down"}, 0));
+    const juce::StringArray directionChoices { "Up", "Centred", "Down" };
 
+    addParameter(base = new juce::AudioParameterChoice("base", "bBase", { "AUTO", "BASE VALUE :" }, 0));
+    addParameter(direction = new juce::AudioParameterChoice("direction", "-Direction", directionChoices, 0));
 
+    // Hosts address automation by index, so new parameters only ever go on the end
+    addParameter(antiRepeat = new juce::AudioParameterBool("antiRepeat", "bNO REPEAT", false));
+    addParameter(deterministic = new juce::AudioParameterBool("deterministic", "bFIXED SEED", false));
+    addParameter(seed = new juce::AudioParameterInt("seed", "-SEED", 0, 9999, 0));
+
+    addParameter(chords = new juce::AudioParameterBool("chords", "bCHORDS", false));
+    addParameter(chordWindow = new juce::AudioParameterInt("chordWindow", "-WINDOW", 0, 50, 10));
+    addParameter(chordSpread = new juce::AudioParameterInt("chordSpread", "-SPREAD", 0, 16, 3));
+
+    addParameter(repetitionAmount = new juce::AudioParameterInt("repetitionAmount", "-FAST REPEATS", 0, 100, 0));
+
+#if ! JucePlugin_IsMidiEffect
+    addParameter(sidechainAmount = new juce::AudioParameterInt("sidechainAmount", "-SIDECHAIN", 0, 100, 0));
+    addParameter(sidechainDetector = new juce::AudioParameterChoice("sidechainDetector", "-Detector", { "Peak", "RMS" }, 0));
+    addParameter(sidechainAttack = new juce::AudioParameterInt("sidechainAttack", "-ATTACK", 1, 100, 5));
+    addParameter(sidechainRelease = new juce::AudioParameterInt("sidechainRelease", "-RELEASE", 10, 1000, 150));
+#endif
+
+    addParameter(useGlobalControls = new juce::AudioParameterBool("globalControls", "bGLOBAL", false));
+
+    for (int i = 0; i < numExtraLanes; ++i)
+    {
+        const auto id = "lane" + juce::String(i + 2);
+        const auto name = "L" + juce::String(i + 2) + " ";
+        auto& lane = lanes[(size_t) i];
+
+        addParameter(lane.channel = new juce::AudioParameterInt(id + "Channel", "-" + name + "CHANNEL", 0, 16, 0));
+        addParameter(lane.range = new juce::AudioParameterInt(id + "Range", "-" + name + "RANGE", 0, 127, 10));
+        addParameter(lane.skew = new juce::AudioParameterInt(id + "Depth", "-" + name + "INTENSITY", 0, 5, 1));
+        addParameter(lane.direction = new juce::AudioParameterChoice(id + "Direction", "-" + name + "Direction", directionChoices, 0));
+    }
+
+    addParameter(freeze = new juce::AudioParameterBool("freeze", "bFREEZE", false));
+
+    for (int i = 0; i < maxDoubles; ++i)
+    {
+        const auto id = "double" + juce::String(i + 1);
+        const auto name = "-D" + juce::String(i + 1) + " ";
+        auto& target = doubles[(size_t) i];
+
+        addParameter(target.channel = new juce::AudioParameterInt(id + "Channel", name + "CHANNEL", 0, 16, 0));
+        addParameter(target.range = new juce::AudioParameterInt(id + "Range", name + "RANGE", 0, 127, 10));
+    }
+
+    addParameter(adaptive = new juce::AudioParameterBool("adaptive", "bADAPTIVE", false));
+
+    for (auto& state : laneStates)
+        state.reset();
+
+    curveTable = pendingCurveTable = curve.createTable();
+
+    capturedParameterValues.resize((size_t) getParameters().size());
+    housekeeping->add(this);
+}
+
+// juce::Random's default constructor folds in a process-wide seed without any locking,
+// which is a data race when a host creates instances on several threads at once.
+juce::int64 NewProjectAudioProcessor::makeInstanceSeed() noexcept
+{
+    static std::atomic<std::uint64_t> instancesCreated { 0 };
+
+    CounterRandom random((std::uint64_t) juce::Time::getHighResolutionTicks(),
+                         (std::int64_t) instancesCreated.fetch_add(1, std::memory_order_relaxed), 0, 0);
+
+    return (juce::int64) (((std::uint64_t) random.nextUint32() << 32) | random.nextUint32());
 }
 
 NewProjectAudioProcessor::~NewProjectAudioProcessor()
 {
+    housekeeping->remove(this);
+}
+
+//==============================================================================
+void ProcessorHousekeeping::add(NewProjectAudioProcessor* processor)
+{
+    const juce::ScopedLock sl(lock);
+    processors.add(processor);
+
+    if (! isTimerRunning())
+        startTimerHz(10);
+}
+
+void ProcessorHousekeeping::remove(NewProjectAudioProcessor* processor)
+{
+    // waits for a callback that's running on this instance to finish
+    const juce::ScopedLock sl(lock);
+    processors.removeFirstMatchingValue(processor);
+}
+
+void ProcessorHousekeeping::timerCallback()
+{
+    const juce::ScopedLock sl(lock);
+
+    for (auto* processor : processors)
+        processor->runHousekeeping();
 }
 
 //==============================================================================
@@ -103,12 +196,40 @@ void NewProjectAudioProcessor::changeProgramName(int index, const juce::String&
 //==============================================================================
 void NewProjectAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
+    TRACE_SCOPE("prepareToPlay");
+
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
-    notes.clear();                          // [1]
-    time = 0;                               // [4]
-    rand = 111;
-    rate = static_cast<float> (sampleRate); // [5]
+    performance.reset();
+    samplePosition = 0;
+
+    for (auto& state : laneStates)
+        state.reset();
+
+    {
+        const juce::SpinLock::ScopedLockType lock(captureLock);
+        captureNeedsSnapshot = true;
+    }
+
+#if ! JucePlugin_IsMidiEffect
+    sidechainBusIndex = -1;
+
+    for (int i = 0; i < getBusCount(true); ++i)
+        if (getBus(true, i)->getName() == "Sidechain")
+            sidechainBusIndex = i;
+
+    sidechainFollower.prepare(sampleRate, samplesPerBlock);
+#else
+    juce::ignoreUnused(sampleRate);
+#endif
+
+    // room for a three-byte event on every sample, plus all their doubles, so processBlock
+    // only has to grow them for a block denser than that. Any lane can own every channel.
+    const auto midiBytesPerBlock = (size_t) juce::jmax(samplesPerBlock, minMidiEventsPerBlock) * midiBytesPerEvent * (1 + maxDoubles);
+    processedMidi.ensureSize(midiBytesPerBlock);
+
+    for (auto& output : laneMidi)
+        output.ensureSize(midiBytesPerBlock);
 }
 
 void NewProjectAudioProcessor::releaseResources()
@@ -138,81 +259,431 @@ bool NewProjectAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts
         return false;
 #endif
 
+    // the sidechain is the last input bus and may be off, mono or stereo
+    if (! layouts.inputBuses.isEmpty())
+    {
+        auto sidechain = layouts.inputBuses.getLast();
+
+        if (layouts.inputBuses.size() > (JucePlugin_IsSynth ? 0 : 1)
+            && ! sidechain.isDisabled()
+            && sidechain != juce::AudioChannelSet::mono()
+            && sidechain != juce::AudioChannelSet::stereo())
+            return false;
+    }
+
     return true;
 #endif
 }
 #endif
 
-void NewProjectAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi)
+juce::int64 NewProjectAudioProcessor::getBlockStartPosition()
 {
+    // while the transport runs, the host timeline makes fixed-seed results independent
+    // of where playback started and of how the host splits the timeline into blocks
+    if (auto* playHead = getPlayHead())
+        if (auto position = playHead->getPosition())
+            if (auto timeInSamples = position->getTimeInSamples())
+                if (position->getIsPlaying())
+                    return *timeInSamples;
 
-    // the audio buffer in a midi effect will have zero channels!
-    // but we need an audio buffer to getNumSamples....so....this next line will stay commented
-    //jassert(buffer.getNumChannels() == 0);                                                         // [6]
+    return samplePosition;
+}
 
-    // however we use the buffer to get timing information
-    auto numSamples = buffer.getNumSamples();                                                       // [7]
+namespace
+{
+    // MidiBuffer's storage for each event: its time, its size, then its bytes
+    constexpr int midiEventHeaderBytes = (int) (sizeof(juce::int32) + sizeof(juce::uint16));
 
-    juce::MidiBuffer processedMidi;
+    // Adds a three-byte event to the end of buffer, which must hold nothing later than
+    // sampleNumber. addEvent() would search the whole buffer for where it goes, and
+    // writing a block that way is quadratic in its number of events.
+    void appendEvent(juce::MidiBuffer& buffer, juce::uint8 status, int noteNumber, int velocity, int sampleNumber) noexcept
+    {
+        const auto time = (juce::int32) sampleNumber;
+        const auto size = (juce::uint16) 3;
+        juce::uint8 event[midiEventHeaderBytes + 3];
 
-    juce::MidiMessage m;
+        memcpy(event, &time, sizeof(time));
+        memcpy(event + sizeof(time), &size, sizeof(size));
+        event[midiEventHeaderBytes] = status;
+        event[midiEventHeaderBytes + 1] = (juce::uint8) noteNumber;
+        event[midiEventHeaderBytes + 2] = (juce::uint8) velocity;
 
+        buffer.data.addArray(event, (int) sizeof(event));
+    }
 
-    for (const auto metadata : midi)                                                             
+    juce::int32 getEventTime(const juce::uint8* event) noexcept
     {
-        const auto msg = metadata.getMessage();
+        juce::int32 time;
+        memcpy(&time, event, sizeof(time));
+        return time;
+    }
 
-        if (msg.isNoteOn())
+    int getEventTotalBytes(const juce::uint8* event) noexcept
+    {
+        juce::uint16 size;
+        memcpy(&size, event + sizeof(juce::int32), sizeof(size));
+        return midiEventHeaderBytes + size;
+    }
+}
+
+template <BaseMode baseMode, VariationDirection direction, SkewClass skewClass, bool fixedSeed>
+int NewProjectAudioProcessor::processEvents(const juce::MidiBuffer& midi, juce::MidiBuffer& laneOutput, const BlockContext& block)
+{
+    int noteOnsModified = 0;
+
+    // outside FIXED SEED mode, one stream per block and lane, seeded so a capture can replay it
+    juce::Random liveRandom(block.liveSeed + block.lane);
+
+    for (const auto metadata : midi)
+    {
+        // only look at the raw bytes, building a MidiMessage allocates for long (sysex) events
+        if (metadata.numBytes != 3)
+            continue;
+
+        const auto status = metadata.data[0] & 0xf0;
+
+        // another lane owns this channel
+        if (block.laneForChannel[metadata.data[0] & 0x0f] != block.lane)
+            continue;
+
+        const auto noteNumber = metadata.data[1] & 0x7f;
+        const auto inputVelocity = metadata.data[2] & 0x7f;
+
+        if (status == 0x90 && inputVelocity != 0)
         {
-            auto velocity = (*base) ?
-                (*baseValue) :
-                msg.getVelocity();
+            const auto channel = metadata.data[0] & 0x0f;
+            const auto position = block.startPosition + metadata.samplePosition;
+            auto settings = block.settings;
+            auto velocity = getNoteOnBase<baseMode, direction>(*block.state, block.options, noteNumber, channel, inputVelocity, position, settings);
+
+            if (block.sidechain != nullptr)
+                velocity += getSidechainBias(block.sidechain->getNormalisedLevel(metadata.samplePosition), block.sidechainAmount);
 
-            auto a = direction->getAllValueStrings();
-            auto rand = juce::Random::getSystemRandom().nextInt(*range);
+            const auto freezeTick = block.freeze != nullptr ? FreezeCache::toTick(block.ppqStart + metadata.samplePosition * block.ppqPerSample) : 0;
 
-            if (*skew == 5)
+            // one variation of this note: stream 0 is the note itself, 1.. its doubles, each
+            // with its own random draws and freeze key. A frozen one plays back exactly what
+            // it played the first time round.
+            auto getOutputVelocity = [&] (int stream, const VelocitySettings& s)
             {
-                rand = (juce::Random::getSystemRandom().nextInt(2) == 0) ?  0 : *range;
-            }
-            else
+                const auto key = channel + 16 * stream;
+
+                if (block.freeze != nullptr)
+                    if (const auto frozen = block.freeze->find(freezeTick, noteNumber, key))
+                        return frozen;
+
+                int varied;
+
+                if constexpr (fixedSeed)
+                {
+                    CounterRandom random(block.seed, position, noteNumber, key + 1);
+                    varied = stream == 0 ? varyNoteOn<direction, skewClass>(*block.state, block.options, noteNumber, velocity, position, s, random)
+                                         : getVariedVelocity<direction, skewClass>(velocity, s, random);
+                }
+                else
+                {
+                    varied = stream == 0 ? varyNoteOn<direction, skewClass>(*block.state, block.options, noteNumber, velocity, position, s, liveRandom)
+                                         : getVariedVelocity<direction, skewClass>(velocity, s, liveRandom);
+                }
+
+                varied = clampVelocity(varied);
+
+                // everything frozen is posted to the state's copy; a replayed block has no journal
+                if (block.freezeNewNotes && block.freeze->insert(freezeTick, noteNumber, key, varied) && block.freezeJournal != nullptr)
+                    block.freezeJournal->post({ freezeTick, (juce::uint8) noteNumber, (juce::uint8) key, (juce::uint8) varied, 1 });
+
+                return varied;
+            };
+
+            const auto outputVelocity = getOutputVelocity(0, settings);
+
+            if (outputVelocity != inputVelocity)
+                ++noteOnsModified;
+
+            appendEvent(laneOutput, (juce::uint8) (0x90 | block.outputChannel), noteNumber, outputVelocity, metadata.samplePosition);
+
+            // doubles go straight after the original at the same time, so the lane's output
+            // is written in time order as it is produced and can simply be appended
+            for (int i = 0; i < block.numDoubles; ++i)
             {
-                for (int x = 0; x < *skew; x++)
-                    rand = juce::jmin( (int)*range , rand + juce::Random::getSystemRandom().nextInt((int)(*range / 5)) );
+                auto doubleSettings = settings;
+                doubleSettings.range = block.doubleTargets[(size_t) i].range;
+
+                appendEvent(laneOutput, (juce::uint8) (0x90 | block.doubleTargets[(size_t) i].outputChannel), noteNumber,
+                            getOutputVelocity(i + 1, doubleSettings), metadata.samplePosition);
             }
-           
-            
+        }
+        else if (status == 0x80 || status == 0x90)
+        {
+            appendEvent(laneOutput, (juce::uint8) (0x80 | block.outputChannel), noteNumber, 0, metadata.samplePosition);
 
-            switch(a.indexOf(direction->getCurrentValueAsText()))
-            {
-                 case 0: velocity += rand;  break;
+            for (int i = 0; i < block.numDoubles; ++i)
+                appendEvent(laneOutput, (juce::uint8) (0x80 | block.doubleTargets[(size_t) i].outputChannel), noteNumber, 0, metadata.samplePosition);
+        }
+    }
 
-                 case 1: velocity -= (int)(*range/2); 
-                         velocity += rand; break;
+    return noteOnsModified;
+}
 
-                 case 2: velocity -= rand; break;
+NewProjectAudioProcessor::EventKernel NewProjectAudioProcessor::getEventKernel(BaseMode baseMode, VariationDirection direction,
+                                                                               SkewClass skewClass, bool fixedSeed) noexcept
+{
+    return fixedSeed ? KernelTable<EventKernels<true>::Of>::get(baseMode, direction, skewClass)
+                     : KernelTable<EventKernels<false>::Of>::get(baseMode, direction, skewClass);
+}
 
-                 default: velocity += 1; break;
-            }
+NewProjectAudioProcessor::BlockContext NewProjectAudioProcessor::readBlockContext()
+{
+    BlockContext block;
+    block.settings.range = *range;
+    block.settings.skew = *skew;
+    block.settings.baseValue = *baseValue;
+    block.settings.curve = curveTable.data();
+    block.options.antiRepeat = *antiRepeat;
+    block.seed = (std::uint64_t) (int) *seed;
+    block.liveSeed = liveSeeds.nextInt64();
+    block.startPosition = getBlockStartPosition();
+    block.options.chords = *chords;
+    block.options.chordWindow = (juce::int64) (*chordWindow * 0.001 * getSampleRate());
+    block.options.chordSpread = *chordSpread;
+    block.options.repetitionAmount = *repetitionAmount;
+    block.options.fastInterval = (juce::int64) (0.25 * getSampleRate());     // repeats faster than 1/4 s count as fast
+
+    // the heavier tier for bounces. FIXED SEED promises the same velocities whatever
+    // the render mode, so it always stays on the real-time tier.
+    block.options.offlineQuality = isNonRealtime() && ! *deterministic;
+
+    for (auto& target : doubles)
+        if (*target.channel > 0)
+            block.doubleTargets[(size_t) block.numDoubles++] = { *target.channel - 1, *target.range };
+
+    // musical position, for FREEZE. processBlock decides whether the cache is used
+    if (auto* playHead = getPlayHead())
+        if (auto position = playHead->getPosition())
+            if (auto ppq = position->getPpqPosition())
+                if (auto bpm = position->getBpm())
+                    if (position->getIsPlaying() && getSampleRate() > 0.0)
+                    {
+                        block.ppqStart = *ppq;
+                        block.ppqPerSample = *bpm / (60.0 * getSampleRate());
+                    }
+
+    // one atomic load, so a controller can move every attached instance at once. Until
+    // housekeeping has attached, GLOBAL has nothing to follow yet.
+    const auto* controls = globalControls.load(std::memory_order_acquire);
+
+    if (*useGlobalControls && controls != nullptr)
+    {
+        const auto global = controls->read();
+
+        if (global.valid)
+        {
+            block.rangeScale = global.amountPercent;
+            block.seed = global.seed;
+        }
+    }
+
+    return block;
+}
+
+int NewProjectAudioProcessor::processLanes(const juce::MidiBuffer& midi, const BlockContext& block)
+{
+    // channels claimed by an extra lane, everything else goes through the main lane on channel 1
+    std::array<juce::int8, 16> laneForChannel {};
+
+    for (int i = 0; i < numExtraLanes; ++i)
+        if (const auto channel = lanes[(size_t) i].channel->get())
+            laneForChannel[(size_t) channel - 1] = (juce::int8) (i + 1);
+
+    int noteOnsModified = 0;
+
+    for (auto& output : laneMidi)
+        output.clear();
+
+    for (int lane = 0; lane <= numExtraLanes; ++lane)
+    {
+        auto laneBlock = block;
+        auto laneDirection = direction->getIndex();
+
+        if (lane > 0)
+        {
+            const auto& params = lanes[(size_t) lane - 1];
+
+            // off, or its channel was taken by a later lane
+            if (*params.channel == 0 || laneForChannel[(size_t) *params.channel - 1] != lane)
+                continue;
+
+            laneBlock.settings.range = *params.range;
+            laneBlock.settings.skew = *params.skew;
+            laneBlock.outputChannel = *params.channel - 1;
+            laneDirection = params.direction->getIndex();
+        }
+
+        laneBlock.lane = lane;
+        laneBlock.state = &laneStates[(size_t) lane];
+        laneBlock.laneForChannel = laneForChannel.data();
+        laneBlock.settings.range = juce::jmin(127, (laneBlock.settings.range * block.rangeScale + 50) / 100);
+
+        // scaled here rather than in readBlockContext(), so a replay's captured rangeScale applies too
+        for (int i = 0; i < laneBlock.numDoubles; ++i)
+        {
+            auto& target = laneBlock.doubleTargets[(size_t) i];
+            target.range = juce::jmin(127, (target.range * block.rangeScale + 50) / 100);
+        }
+
+        // pick the instantiation for this lane's modes once, the per-note path has no mode branches.
+        // Each lane writes its own events in time order, merged below.
+        const auto kernel = getEventKernel(*base ? BaseMode::fixed : (*adaptive ? BaseMode::adaptive : BaseMode::input),
+                                           (VariationDirection) laneDirection,
+                                           getSkewClass(laneBlock.settings.skew),
+                                           *deterministic);
+
+        noteOnsModified += (this->*kernel)(midi, laneMidi[(size_t) lane], laneBlock);
+    }
 
-             
-            processedMidi.addEvent(juce::MidiMessage::noteOn(1, msg.getNoteNumber(), (juce::uint8)velocity), msg.getTimeStamp());
+    mergeLaneOutputs();
+    return noteOnsModified;
+}
+
+void NewProjectAudioProcessor::mergeLaneOutputs() noexcept
+{
+    std::array<int, numExtraLanes + 1> read {};
+    int numWithEvents = 0, onlyLane = 0;
+
+    for (size_t lane = 0; lane < laneMidi.size(); ++lane)
+    {
+        if (! laneMidi[lane].isEmpty())
+        {
+            ++numWithEvents;
+            onlyLane = (int) lane;
         }
-        else if (msg.isNoteOff())
+    }
+
+    // usually only the main lane has anything to say
+    if (numWithEvents <= 1)
+    {
+        const auto& only = laneMidi[(size_t) onlyLane].data;
+        processedMidi.data.addArray(only.begin(), only.size());
+        return;
+    }
+
+    // one pass, always taking the earliest next event; on a tie the lower lane's goes first
+    for (;;)
+    {
+        int earliest = -1;
+        juce::int32 earliestTime = 0;
+
+        for (int lane = 0; lane < (int) laneMidi.size(); ++lane)
         {
-            notes.removeValue(msg.getNoteNumber());
-            processedMidi.addEvent(juce::MidiMessage::noteOff(1, msg.getNoteNumber()), msg.getTimeStamp());
+            const auto& data = laneMidi[(size_t) lane].data;
+
+            if (read[(size_t) lane] < data.size())
+            {
+                const auto time = getEventTime(data.begin() + read[(size_t) lane]);
+
+                if (earliest < 0 || time < earliestTime)
+                {
+                    earliest = lane;
+                    earliestTime = time;
+                }
+            }
         }
+
+        if (earliest < 0)
+            break;
+
+        const auto* event = laneMidi[(size_t) earliest].data.begin() + read[(size_t) earliest];
+        const auto numBytes = getEventTotalBytes(event);
+
+        processedMidi.data.addArray(event, numBytes);
+        read[(size_t) earliest] += numBytes;
     }
+}
 
+void NewProjectAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi)
+{
+    TRACE_SCOPE("processBlock");
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    // the audio buffer in a midi effect will have zero channels!
+    // but we need an audio buffer to getNumSamples....so....this next line will stay commented
+    //jassert(buffer.getNumChannels() == 0);                                                         // [6]
 
+    // however we use the buffer to get timing information
+    auto numSamples = buffer.getNumSamples();                                                       // [7]
+
+    processedMidi.clear();
+
+   #if JUCE_DEBUG
+    const auto allocatedMidiBytes = processedMidi.data.getNumAllocated();
+   #endif
+
+    {
+        // never wait for the editor, if it is busy the new curve arrives next block
+        const juce::SpinLock::ScopedTryLockType lock(curveLock);
+
+        if (lock.isLocked() && curveTablePending)
+        {
+            curveTable = pendingCurveTable;
+            curveTablePending = false;
+        }
+    }
+
+    auto block = readBlockContext();
+
+#if ! JucePlugin_IsMidiEffect
+    if (*sidechainAmount > 0 && sidechainBusIndex >= 0 && getBus(true, sidechainBusIndex)->isEnabled())
+    {
+        sidechainFollower.setTimes((float) *sidechainAttack, (float) *sidechainRelease);
+        sidechainFollower.process(getBusBuffer(buffer, true, sidechainBusIndex), numSamples, sidechainDetector->getIndex() == 1);
+        block.sidechain = &sidechainFollower;
+        block.sidechainAmount = *sidechainAmount;
+    }
+#endif
+
+    // if the message thread is swapping tables, this block's notes are varied but not frozen
+    const juce::SpinLock::ScopedTryLockType freezeScope(freezeLock);
+
+    if (*freeze && block.ppqPerSample > 0.0 && freezeScope.isLocked() && freezeJournal != nullptr)
+    {
+        block.freeze = &freezeCache;
+        block.freezeJournal = freezeJournal.get();
+
+        // decided once for the whole block, so a capture can record it: each note-on freezes
+        // at most itself and its doubles. If the journal can't take that many, this block only
+        // plays back what is already frozen.
+        block.freezeNewNotes = freezeJournal->getFreeSpace() >= midi.getNumEvents() * (1 + block.numDoubles);
+    }
+
+    // if the editor is starting or stopping a capture, this block just isn't recorded
+    const juce::SpinLock::ScopedTryLockType captureScope(captureLock);
+    auto* capture = captureScope.isLocked() && captureWriter != nullptr
+                     && beginCapturedBlock(*captureWriter, freezeScope.isLocked() ? &freezeCache : nullptr) ? captureWriter.get() : nullptr;
+
+    const auto noteOnsModified = processLanes(midi, block);
+
+    if (capture != nullptr)
+        captureBlock(*capture, midi, block, numSamples);
+
+    const auto numEventsIn = midi.getNumEvents();
     midi.clear();                                                                                   // [10]
 
- 
-    //time = (time + numSamples) % noteDuration;                                                      // [15]
+    // copy back instead of swapWith(), so processedMidi keeps the storage reserved in
+    // prepareToPlay. Without doubles the host's buffer already held at least as many bytes
+    // as we write, and clear() keeps its allocation, so neither buffer allocates here. With
+    // doubles it can grow the first time a block is denser than any before it. The bytes are
+    // already in MidiBuffer's sorted layout, so they go over in one copy.
+    midi.data.addArray(processedMidi.data.begin(), processedMidi.data.size());
+
+    // if this fires, a block produced more MIDI than prepareToPlay reserved and the audio thread allocated
+    jassert(processedMidi.data.getNumAllocated() == allocatedMidiBytes);
+
+    samplePosition += numSamples;
 
-    //always use swapWith(), avoids unpredictable behavior from directly editing midi buffer
-    midi.swapWith(processedMidi);
+    const auto budget = getSampleRate() > 0.0 ? numSamples / getSampleRate() : 0.0;
+    performance.addBlock(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks),
+                         budget, numEventsIn, midi.getNumEvents(), noteOnsModified);
 }
 
 //==============================================================================
@@ -229,40 +700,462 @@ juce::AudioProcessorEditor* NewProjectAudioProcessor::createEditor()
 //==============================================================================
 void NewProjectAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+    // every parameter is stored by ID, so adding parameters doesn't break older sessions
+    juce::XmlElement xml("MIDIVelocityVariation");
 
-    juce::MemoryOutputStream(destData, true).writeInt(*range);
-    juce::MemoryOutputStream(destData, true).writeInt(*direction);
-    juce::MemoryOutputStream(destData, true).writeInt(*skew);
-    juce::MemoryOutputStream(destData, true).writeInt(*baseValue);
+    for (auto* p : getParameters())
+        if (auto* withID = dynamic_cast<juce::AudioProcessorParameterWithID*> (p))
+            xml.setAttribute(withID->paramID, p->getValue());
 
-    juce::MemoryOutputStream(destData, true).writeInt(*base);
+    xml.setAttribute("curve", curve.toString());
 
+    {
+        // the message thread's own copy, so the audio thread's lookups carry on meanwhile
+        const juce::ScopedLock sl(freezeStateLock);
+
+        if (freezeJournal != nullptr)
+            freezeJournal->drainInto(frozenState);
 
-    //juce::MemoryOutputStream(destData, true).writeInt(*sync);
-  
+        if (frozenState.size() > 0)
+            xml.setAttribute("freeze", frozenState.toBase64());
+    }
 
+    copyXmlToBinary(xml, destData);
 }
 
 void NewProjectAudioProcessor::setStateInformation(const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    TRACE_SCOPE("setStateInformation");
+
+    if (auto xml = getXmlFromBinary(data, sizeInBytes))
+    {
+        for (auto* p : getParameters())
+            if (auto* withID = dynamic_cast<juce::AudioProcessorParameterWithID*> (p))
+                if (xml->hasAttribute(withID->paramID))
+                    p->setValueNotifyingHost((float) xml->getDoubleAttribute(withID->paramID));
+
+        if (xml->hasAttribute("curve"))
+            setCurve(VelocityCurve::fromString(xml->getStringAttribute("curve")));
+
+        {
+            // a session saved with FREEZE off has no table to load
+            FreezeCache loaded;
+
+            if (*freeze)
+                loaded.fromBase64(xml->getStringAttribute("freeze"), freezeCapacity);
+
+            const juce::ScopedLock sl(freezeStateLock);
+            installFreezeTable(std::move(loaded));
+        }
+
+        return;
+    }
+
+    // sessions saved by older versions hold raw ints: range, direction, skew, baseValue, base
+    juce::MemoryInputStream stream(data, static_cast<size_t> (sizeInBytes), false);
+
+    if (stream.getNumBytesRemaining() < 5 * (juce::int64) sizeof(int))
+        return;
+
+    *range = stream.readInt();
+    *direction = stream.readInt();
+    *skew = stream.readInt();
+    *baseValue = stream.readInt();
+    *base = stream.readInt();
+}
+
+//==============================================================================
+void NewProjectAudioProcessor::setCurve(const VelocityCurve& newCurve)
+{
+    curve = newCurve;
+
+    {
+        const juce::SpinLock::ScopedLockType lock(curveLock);
+        pendingCurveTable = curve.createTable();
+        curveTablePending = true;
+    }
+
+    curveBroadcaster.sendChangeMessage();
+}
+
+//==============================================================================
+void NewProjectAudioProcessor::rerollFreeze()
+{
+    const juce::ScopedLock sl(freezeStateLock);
+
+    if (frozenState.getCapacity() == 0)
+        return;
+
+    FreezeCache empty;
+    empty.reserve(freezeCapacity);
+    installFreezeTable(std::move(empty));
+}
+
+void NewProjectAudioProcessor::runHousekeeping()
+{
+    // opening the shared memory creates it, so only do that once someone wants it
+    if (*useGlobalControls && globalControlsAttachment == nullptr)
+    {
+        globalControlsAttachment = std::make_unique<juce::SharedResourcePointer<GlobalControls>>();
+        globalControls.store(&globalControlsAttachment->getObject(), std::memory_order_release);
+    }
+
+    const juce::ScopedLock sl(freezeStateLock);
+
+    // FREEZE may have been switched by host automation on the audio thread, which can't
+    // allocate, so the table follows it from here. Switching it off forgets the take.
+    const auto tableWanted = freeze->get();
+
+    if (tableWanted != (frozenState.getCapacity() > 0))
+    {
+        FreezeCache table;
+
+        if (tableWanted)
+            table.reserve(freezeCapacity);
+
+        installFreezeTable(std::move(table));
+    }
+    else if (freezeJournal != nullptr)
+    {
+        freezeJournal->drainInto(frozenState);
+    }
+}
+
+void NewProjectAudioProcessor::installFreezeTable(FreezeCache table)
+{
+    auto journal = table.getCapacity() > 0 ? std::make_unique<FreezeJournal>(freezeJournalSize) : nullptr;
+    frozenState.setEntries(table.getEntries(), table.getCapacity());
+
+    {
+        const juce::SpinLock::ScopedLockType lock(freezeLock);
+        std::swap(freezeCache, table);
+        std::swap(freezeJournal, journal);
+    }
+
+    {
+        // a capture running now has to record the new table before its next block
+        const juce::SpinLock::ScopedLockType lock(captureLock);
+        captureNeedsSnapshot = true;
+    }
+
+    // the old table and journal are freed here, outside the locks
+}
+
+//==============================================================================
+bool NewProjectAudioProcessor::startCapture(const juce::File& file)
+{
+    auto writer = std::make_unique<CaptureWriter>(file);
+
+    if (! writer->isOpen())
+        return false;
+
+    {
+        const juce::SpinLock::ScopedLockType lock(captureLock);
+        std::swap(captureWriter, writer);
+        captureNeedsSnapshot = true;
+    }
+
+    return true;    // a previous capture, now in writer, is finished off outside the lock
+}
+
+void NewProjectAudioProcessor::stopCapture()
+{
+    std::unique_ptr<CaptureWriter> finished;
+
+    {
+        const juce::SpinLock::ScopedLockType lock(captureLock);
+        std::swap(captureWriter, finished);
+    }
+}
+
+bool NewProjectAudioProcessor::isCapturing() const
+{
+    const juce::SpinLock::ScopedLockType lock(captureLock);
+    return captureWriter != nullptr;
+}
+
+bool NewProjectAudioProcessor::beginCapturedBlock(CaptureWriter& writer, const FreezeCache* freezeTable) noexcept
+{
+    // the note history and freeze table before this block, so a replay can start here.
+    // Needed at the start, after prepareToPlay, after a new freeze table and after anything
+    // was dropped
+    if (! captureNeedsSnapshot)
+        return true;
+
+    // the message thread holds the table; record nothing until it can be read
+    if (freezeTable == nullptr)
+        return false;
+
+    CapturedSnapshot snapshot;
+    snapshot.sampleRate = getSampleRate();
+    snapshot.blockSize = getBlockSize();
+    snapshot.freezeCapacity = freezeTable != nullptr ? freezeTable->getCapacity() : 0;
+
+    static_assert(std::is_trivially_copyable<NoteHistory>::value, "lane state is captured as raw bytes");
+
+    if (! writer.writeRecord(CaptureLog::RecordType::snapshot,
+                             { { &snapshot, sizeof(snapshot) },
+                               { laneStates.data(), sizeof(laneStates) },
+                               { freezeTable != nullptr ? freezeTable->getEntries() : nullptr,
+                                 (size_t) snapshot.freezeCapacity * sizeof(FreezeCache::Entry) } }))
+        return false;
+
+    captureNeedsSnapshot = false;
+    return true;
+}
+
+void NewProjectAudioProcessor::captureBlock(CaptureWriter& writer, const juce::MidiBuffer& input,
+                                            const BlockContext& block, int numSamples) noexcept
+{
+    auto countEvents = [] (const juce::MidiBuffer& buffer)
+    {
+        juce::int32 n = 0;
+
+        for (const auto metadata : buffer)
+            if (metadata.numBytes == 3)
+                ++n;
+
+        return n;
+    };
+
+    auto appendEvents = [&writer] (const juce::MidiBuffer& buffer)
+    {
+        for (const auto metadata : buffer)
+        {
+            if (metadata.numBytes == 3)
+            {
+                const CapturedEvent event { metadata.samplePosition, { metadata.data[0], metadata.data[1], metadata.data[2], 0 } };
+                writer.append(&event, sizeof(event));
+            }
+        }
+    };
+
+    const auto& parameters = getParameters();
+
+    for (int i = 0; i < parameters.size(); ++i)
+        capturedParameterValues[(size_t) i] = parameters.getUnchecked(i)->getValue();
+
+    CapturedBlock captured;
+    captured.startPosition = block.startPosition;
+    captured.liveSeed = block.liveSeed;
+    captured.seed = block.seed;
+    captured.ppqStart = block.ppqStart;
+    captured.ppqPerSample = block.ppqPerSample;
+    captured.numSamples = numSamples;
+    captured.rangeScale = block.rangeScale;
+    captured.numParameters = parameters.size();
+    captured.numInputEvents = countEvents(input);
+    captured.numOutputEvents = countEvents(processedMidi);
+    captured.numSidechainSamples = block.sidechain != nullptr ? block.sidechain->getNumSamples() : 0;
+    captured.sidechainRms = block.sidechain != nullptr && block.sidechain->isRms() ? 1 : 0;
+    captured.frozen = block.freeze == nullptr ? 0 : (block.freezeNewNotes ? 1 : 2);
+    captured.offline = block.options.offlineQuality ? 1 : 0;
+
+    const auto size = sizeof(captured)
+                    + (size_t) captured.numParameters * sizeof(float)
+                    + sizeof(curveTable)
+                    + (size_t) (captured.numInputEvents + captured.numOutputEvents) * sizeof(CapturedEvent)
+                    + (size_t) captured.numSidechainSamples * sizeof(float);
+
+    if (! writer.beginRecord(CaptureLog::RecordType::block, size))
+    {
+        // the gap tells a replay to wait for the snapshot that follows it
+        writer.writeRecord(CaptureLog::RecordType::gap, {});
+        captureNeedsSnapshot = true;
+        return;
+    }
+
+    writer.append(&captured, sizeof(captured));
+    writer.append(capturedParameterValues.data(), (size_t) captured.numParameters * sizeof(float));
+    writer.append(curveTable.data(), sizeof(curveTable));
+    appendEvents(input);
+    appendEvents(processedMidi);
+
+    if (captured.numSidechainSamples > 0)
+        writer.append(block.sidechain->getEnvelope(), (size_t) captured.numSidechainSamples * sizeof(float));
+}
+
+int NewProjectAudioProcessor::replayCapture(juce::InputStream& log, const std::function<void(const ReplayedBlock&)>& callback)
+{
+    char fileMagic[sizeof(CaptureLog::magic)];
+
+    if (log.read(fileMagic, (int) sizeof(fileMagic)) != (int) sizeof(fileMagic)
+         || memcmp(fileMagic, CaptureLog::magic, sizeof(fileMagic)) != 0)
+        return -1;
+
+    juce::MemoryBlock payload;
+    juce::MidiBuffer input, recordedOutput;
+    bool inSync = false;
+    int mismatches = 0;
+
+    auto readEvents = [] (const char*& data, int numEvents, juce::MidiBuffer& buffer)
+    {
+        buffer.clear();
+
+        for (int i = 0; i < numEvents; ++i, data += sizeof(CapturedEvent))
+        {
+            CapturedEvent event;
+            memcpy(&event, data, sizeof(event));
+            buffer.addEvent(event.bytes, 3, event.samplePosition);
+        }
+    };
+
+    auto isSame = [] (const juce::MidiBuffer& a, const juce::MidiBuffer& b)
+    {
+        auto i = a.begin(), j = b.begin();
+
+        for (; i != a.end() && j != b.end(); ++i, ++j)
+            if ((*i).samplePosition != (*j).samplePosition || (*i).numBytes != (*j).numBytes
+                 || memcmp((*i).data, (*j).data, (size_t) (*i).numBytes) != 0)
+                return false;
+
+        return i == a.end() && j == b.end();
+    };
+
+    for (;;)
+    {
+        juce::uint8 type = 0;
+        juce::uint32 size = 0;
+
+        if (log.read(&type, 1) != 1 || log.read(&size, (int) sizeof(size)) != (int) sizeof(size))
+            break;
+
+        payload.setSize(size);
+
+        if (log.read(payload.getData(), (int) size) != (int) size)
+            break;
+
+        const auto* data = static_cast<const char*> (payload.getData());
+
+        switch ((CaptureLog::RecordType) type)
+        {
+            case CaptureLog::RecordType::snapshot:
+            {
+                CapturedSnapshot snapshot;
+                memcpy(&snapshot, data, sizeof(snapshot));
+
+                if (size != sizeof(CapturedSnapshot) + sizeof(laneStates) + (size_t) snapshot.freezeCapacity * sizeof(FreezeCache::Entry))
+                    return -1;
+
+                setRateAndBufferSizeDetails(snapshot.sampleRate, snapshot.blockSize);
+                prepareToPlay(snapshot.sampleRate, snapshot.blockSize);
+                memcpy(laneStates.data(), data + sizeof(snapshot), sizeof(laneStates));
+
+                {
+                    // the captured table, or none, replacing whatever this instance had frozen
+                    const juce::SpinLock::ScopedLockType lock(freezeLock);
+                    freezeCache.setEntries(reinterpret_cast<const FreezeCache::Entry*> (data + sizeof(snapshot) + sizeof(laneStates)),
+                                           snapshot.freezeCapacity);
+                }
+
+                inSync = true;
+                break;
+            }
+
+            case CaptureLog::RecordType::gap:
+                inSync = false;
+                break;
+
+            case CaptureLog::RecordType::block:
+            {
+                if (! inSync || size < sizeof(CapturedBlock))
+                    break;
+
+                CapturedBlock captured;
+                memcpy(&captured, data, sizeof(captured));
+                data += sizeof(captured);
+
+                const auto& parameters = getParameters();
+
+                if (captured.numParameters != parameters.size())
+                    return -1;
+
+                for (int i = 0; i < captured.numParameters; ++i, data += sizeof(float))
+                {
+                    float value;
+                    memcpy(&value, data, sizeof(value));
+                    parameters.getUnchecked(i)->setValue(value);
+                }
+
+                memcpy(curveTable.data(), data, sizeof(curveTable));
+                data += sizeof(curveTable);
+
+                readEvents(data, captured.numInputEvents, input);
+                readEvents(data, captured.numOutputEvents, recordedOutput);
+
+                auto block = readBlockContext();
+                block.startPosition = captured.startPosition;
+                block.liveSeed = captured.liveSeed;
+                block.seed = captured.seed;
+                block.rangeScale = captured.rangeScale;
+                block.ppqStart = captured.ppqStart;
+                block.ppqPerSample = captured.ppqPerSample;
+                block.freeze = captured.frozen != 0 ? &freezeCache : nullptr;
+                block.freezeNewNotes = captured.frozen == 1;
+                block.options.offlineQuality = captured.offline != 0;
+
+#if ! JucePlugin_IsMidiEffect
+                if (captured.numSidechainSamples > 0)
+                {
+                    sidechainFollower.setEnvelope(reinterpret_cast<const float*> (data), captured.numSidechainSamples, captured.sidechainRms != 0);
+                    block.sidechain = &sidechainFollower;
+                    block.sidechainAmount = *sidechainAmount;
+                }
+#endif
+
+                processedMidi.clear();
+                processLanes(input, block);
+
+                if (! isSame(processedMidi, recordedOutput))
+                    ++mismatches;
+
+                callback({ captured.startPosition, input, recordedOutput, processedMidi });
+                break;
+            }
+
+            default:
+                return -1;
+        }
+    }
+
+    return mismatches;
+}
+
+//==============================================================================
+MemoryFootprint NewProjectAudioProcessor::getMemoryFootprint() const
+{
+    MemoryFootprint footprint;
+
+    footprint.add("processor", sizeof(*this) - sizeof(performance) - sizeof(laneStates)
+                                 - sizeof(sidechainFollower) - sizeof(processedMidi) - sizeof(laneMidi) - sizeof(freezeCache) - sizeof(frozenState)
+                                 - sizeof(curve) - sizeof(pendingCurveTable) - sizeof(curveTable));
+    footprint.add("performance counters", sizeof(performance));
+    footprint.add("lane note history", sizeof(laneStates), (int) laneStates.size());
+    footprint.add("sidechain follower", sizeof(sidechainFollower) + sidechainFollower.getAllocatedBytes());
+    footprint.add("midi scratch buffer", sizeof(processedMidi) + (size_t) processedMidi.data.getNumAllocated());
 
+    size_t laneMidiBytes = sizeof(laneMidi);
 
-    range->setValueNotifyingHost(juce::MemoryInputStream(data, static_cast<size_t> (sizeInBytes), false).readInt());
-    direction->setValueNotifyingHost(juce::MemoryInputStream(data, static_cast<size_t> (sizeInBytes), false).readInt());
-    skew->setValueNotifyingHost(juce::MemoryInputStream(data, static_cast<size_t> (sizeInBytes), false).readInt());
-    baseValue->setValueNotifyingHost(juce::MemoryInputStream(data, static_cast<size_t> (sizeInBytes), false).readInt());
+    for (auto& output : laneMidi)
+        laneMidiBytes += (size_t) output.data.getNumAllocated();
 
-    base->setValueNotifyingHost(juce::MemoryInputStream(data, static_cast<size_t> (sizeInBytes), false).readBool());
-  
+    footprint.add("lane midi buffers", laneMidiBytes, (int) laneMidi.size());
+    footprint.add("freeze cache", sizeof(freezeCache) + (size_t) freezeCache.getCapacity() * sizeof(FreezeCache::Entry)
+                                    + sizeof(frozenState) + (size_t) frozenState.getCapacity() * sizeof(FreezeCache::Entry)
+                                    + (freezeJournal != nullptr ? freezeJournal->getAllocatedBytes() : 0));
+    footprint.add("velocity curve", sizeof(curve) + sizeof(pendingCurveTable) + sizeof(curveTable));
 
-  /*  sync->setValueNotifyingHost(juce::MemoryInputStream(data, static_cast<size_t> (sizeInBytes), false).readBool());*/
+    for (auto* p : getParameters())
+    {
+        if (auto* choice = dynamic_cast<juce::AudioParameterChoice*> (p))
+            footprint.add("parameters", sizeof(juce::AudioParameterChoice) + (size_t) choice->choices.size() * sizeof(juce::String));
+        else if (dynamic_cast<juce::AudioParameterBool*> (p) != nullptr)
+            footprint.add("parameters", sizeof(juce::AudioParameterBool));
+        else
+            footprint.add("parameters", sizeof(juce::AudioParameterInt));
+    }
 
-  
+    return footprint;
 }
 
 //==============================================================================
@@ -9,6 +9,94 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "PerformanceCounters.h"
+#include "CounterRandom.h"
+#include "VelocityEngine.h"
+#include "VelocityCurve.h"
+#include "EnvelopeFollower.h"
+#include "GlobalControls.h"
+#include "Tracing.h"
+#include "CaptureLog.h"
+#include "FreezeCache.h"
+
+//==============================================================================
+class NewProjectAudioProcessor;
+
+/**
+    One message-thread timer for every plugin instance in the process, for the
+    work the audio thread hands back: allocating the FREEZE table when FREEZE
+    is switched on, freeing it when it's switched off, keeping the state's
+    copy of it current, and attaching the global controls the first time
+    GLOBAL is switched on.
+
+    Instances register themselves in their constructor and leave in their
+    destructor; the timer runs at 10 Hz while any are registered.
+*/
+class ProcessorHousekeeping : private juce::Timer
+{
+public:
+    ~ProcessorHousekeeping() override   { stopTimer(); }
+
+    void add(NewProjectAudioProcessor* processor);
+    void remove(NewProjectAudioProcessor* processor);
+
+private:
+    void timerCallback() override;
+
+    juce::CriticalSection lock;
+    juce::Array<NewProjectAudioProcessor*> processors;     // guarded by lock
+};
+
+//==============================================================================
+/**
+    Bytes held by one plugin object, split by subsystem.
+*/
+struct MemoryFootprint
+{
+    struct Item
+    {
+        juce::String subsystem;
+        size_t bytes = 0;
+        int count = 0;
+    };
+
+    void add(const juce::String& subsystem, size_t bytes, int count = 1)
+    {
+        for (auto& item : items)
+        {
+            if (item.subsystem == subsystem)
+            {
+                item.bytes += bytes;
+                item.count += count;
+                return;
+            }
+        }
+
+        items.add({ subsystem, bytes, count });
+    }
+
+    size_t getTotalBytes() const noexcept
+    {
+        size_t total = 0;
+
+        for (auto& item : items)
+            total += item.bytes;
+
+        return total;
+    }
+
+    juce::String toString() const
+    {
+        juce::String s;
+
+        for (auto& item : items)
+            s << item.subsystem << ": " << (juce::int64) item.bytes << " bytes (" << item.count << ")\n";
+
+        return s << "total: " << (juce::int64) getTotalBytes() << " bytes\n";
+    }
+
+    juce::Array<Item> items;
+};
 
 //==============================================================================
 /**
@@ -26,6 +114,56 @@ public:
 
     juce::AudioParameterChoice* base;
     juce::AudioParameterChoice* direction;
+    juce::AudioParameterBool* adaptive;         // AUTO follows each channel's own dynamics
+
+    juce::AudioParameterBool* antiRepeat;
+    juce::AudioParameterBool* deterministic;
+    juce::AudioParameterInt* seed;
+
+    juce::AudioParameterBool* chords;
+    juce::AudioParameterInt* chordWindow;
+    juce::AudioParameterInt* chordSpread;
+
+    juce::AudioParameterInt* repetitionAmount;
+
+#if ! JucePlugin_IsMidiEffect
+    // a MIDI effect has no audio inputs, so no sidechain either
+    juce::AudioParameterInt* sidechainAmount;
+    juce::AudioParameterChoice* sidechainDetector;
+    juce::AudioParameterInt* sidechainAttack;
+    juce::AudioParameterInt* sidechainRelease;
+#endif
+
+    juce::AudioParameterBool* useGlobalControls;
+
+    juce::AudioParameterBool* freeze;
+
+    // Doubles: every note is also sent to each of these channels, for layering one part
+    // on several instruments. Each copy gets its own variation draw and RANGE.
+    static constexpr int maxDoubles = 3;
+
+    struct DoubleParameters
+    {
+        juce::AudioParameterInt* channel = nullptr;     // 1..16, 0 when off
+        juce::AudioParameterInt* range = nullptr;
+    };
+
+    std::array<DoubleParameters, maxDoubles> doubles;
+
+    // Extra lanes, so one instance can humanize several parts (drums, bass, keys...).
+    // Note-ons on a lane's MIDI channel get that lane's settings and note history
+    // instead of the main ones, and come out on the same channel.
+    static constexpr int numExtraLanes = 3;
+
+    struct LaneParameters
+    {
+        juce::AudioParameterInt* channel = nullptr;     // 1..16, 0 when the lane is off
+        juce::AudioParameterInt* range = nullptr;
+        juce::AudioParameterInt* skew = nullptr;
+        juce::AudioParameterChoice* direction = nullptr;
+    };
+
+    std::array<LaneParameters, numExtraLanes> lanes;
     
 
 
@@ -64,14 +202,207 @@ public:
     void getStateInformation(juce::MemoryBlock& destData) override;
     void setStateInformation(const void* data, int sizeInBytes) override;
 
+    //==============================================================================
+    // Bytes owned by this instance alone, split by subsystem (shared data is not counted).
+    MemoryFootprint getMemoryFootprint() const;
+    size_t getBytesPerInstance() const { return getMemoryFootprint().getTotalBytes(); }
+
+    // The input velocity transfer curve. Message thread only; the audio thread
+    // picks up the compiled table at the start of its next block.
+    VelocityCurve getCurve() const { return curve; }
+    void setCurve(const VelocityCurve& newCurve);
+    void addCurveListener(juce::ChangeListener* l)     { curveBroadcaster.addChangeListener(l); }
+    void removeCurveListener(juce::ChangeListener* l)  { curveBroadcaster.removeChangeListener(l); }
+
+    // processBlock timing and event counts, safe to read from any thread
+    const PerformanceCounters& getPerformanceCounters() const noexcept { return performance; }
+    juce::String getPerformanceReport() const { return performance.getSnapshot().toString(); }
+
+    // Forgets every frozen velocity, so the next pass of the loop is varied afresh.
+    // Message thread only.
+    void rerollFreeze();
+
+    // Called by ProcessorHousekeeping on the message thread
+    void runHousekeeping();
+
+    //==============================================================================
+    // Records every block's input, settings and output to a file, so a live session
+    // can be reproduced exactly offline with replayCapture(). Message thread only.
+    bool startCapture(const juce::File& file);
+    void stopCapture();
+    bool isCapturing() const;
+
+    struct ReplayedBlock
+    {
+        juce::int64 startPosition;
+        const juce::MidiBuffer& input;
+        const juce::MidiBuffer& recordedOutput;
+        const juce::MidiBuffer& output;
+    };
+
+    // Runs a capture back through the same kernels, calling back once per block. Returns
+    // the number of blocks whose output differs from the recording, or -1 if the stream
+    // isn't a capture. Don't call while the host is playing this instance.
+    int replayCapture(juce::InputStream& log, const std::function<void(const ReplayedBlock&)>& callback);
+
 private:
     //==============================================================================
+    // Everything processEvents() needs, read from the parameters once per block
+    struct BlockContext
+    {
+        VelocitySettings settings;
+        NoteOptions options;             // chord window and fast interval in samples
+        std::uint64_t seed = 0;
+        juce::int64 startPosition = 0;
+
+        const EnvelopeFollower* sidechain = nullptr;     // null when off or not connected
+        int sidechainAmount = 0;         // percent
+
+        int lane = 0;
+        NoteHistory* state = nullptr;
+        const juce::int8* laneForChannel = nullptr;     // 16 entries, the lane each input channel belongs to
+        int outputChannel = 0;           // 0..15
+
+        int rangeScale = 100;            // percent, from the global controls
+        juce::int64 liveSeed = 0;        // seeds this block's random stream outside FIXED SEED mode
+
+        struct DoubleTarget
+        {
+            int outputChannel = 0;       // 0..15
+            int range = 0;
+        };
+
+        std::array<DoubleTarget, maxDoubles> doubleTargets;
+        int numDoubles = 0;
+
+        FreezeCache* freeze = nullptr;   // null when FREEZE is off or the transport isn't playing
+        FreezeJournal* freezeJournal = nullptr;
+        bool freezeNewNotes = false;     // false when the journal might not take every note in the block
+        double ppqStart = 0.0;
+        double ppqPerSample = 0.0;
+    };
+
+    // The fixed part of a captured block, followed by the parameter values, the curve
+    // table, the input and output events and, when the sidechain was active, its envelope
+    struct CapturedBlock
+    {
+        juce::int64 startPosition;
+        juce::int64 liveSeed;
+        juce::uint64 seed;
+        double ppqStart;
+        double ppqPerSample;
+        juce::int32 numSamples;
+        juce::int32 rangeScale;
+        juce::int32 numParameters;
+        juce::int32 numInputEvents;
+        juce::int32 numOutputEvents;
+        juce::int32 numSidechainSamples;    // 0 when the sidechain was off
+        juce::int32 sidechainRms;
+        juce::int32 frozen;                 // 0 off, 1 new notes frozen, 2 only frozen ones played back
+        juce::int32 offline;                // the offline quality tier was used
+    };
+
+    struct CapturedEvent
+    {
+        juce::int32 samplePosition;
+        juce::uint8 bytes[4];   // the last byte is padding
+    };
+
+    struct CapturedSnapshot
+    {
+        double sampleRate;
+        juce::int32 blockSize;
+        juce::int32 freezeCapacity;     // 0 when the freeze table wasn't captured
+    };
+
+    // Returns the number of note-ons whose velocity changed
+    using EventKernel = int (NewProjectAudioProcessor::*)(const juce::MidiBuffer&, juce::MidiBuffer&, const BlockContext&);
+
+    template <BaseMode baseMode, VariationDirection direction, SkewClass skewClass, bool fixedSeed>
+    int processEvents(const juce::MidiBuffer& midi, juce::MidiBuffer& laneOutput, const BlockContext& block);
+
+    template <bool fixedSeed>
+    struct EventKernels
+    {
+        template <BaseMode baseMode, VariationDirection direction, SkewClass skewClass>
+        struct Of
+        {
+            static constexpr EventKernel value = &NewProjectAudioProcessor::processEvents<baseMode, direction, skewClass, fixedSeed>;
+        };
+    };
+
+    static EventKernel getEventKernel(BaseMode, VariationDirection, SkewClass, bool fixedSeed) noexcept;
+    static juce::int64 makeInstanceSeed() noexcept;
+
+    juce::int64 getBlockStartPosition();
+
+    // Reads the parameters, playhead and global controls; everything but the sidechain
+    BlockContext readBlockContext();
+
+    // Runs every active lane's kernel over midi into processedMidi, returns the note-ons modified
+    int processLanes(const juce::MidiBuffer& midi, const BlockContext& block);
+
+    // Appends the lanes' outputs to processedMidi in time order, in one pass
+    void mergeLaneOutputs() noexcept;
+
+    bool beginCapturedBlock(CaptureWriter& writer, const FreezeCache* freezeTable) noexcept;
+    void captureBlock(CaptureWriter& writer, const juce::MidiBuffer& input, const BlockContext& block, int numSamples) noexcept;
+
+    // Message thread, under freezeStateLock: swaps a new FREEZE table in, with a journal
+    // if it has any room, and makes frozenState a copy of it
+    void installFreezeTable(FreezeCache table);
+
+    //==============================================================================
+    juce::SharedResourcePointer<ProcessorHousekeeping> housekeeping;
+
+   #if MIDI_VELOCITY_TRACING
+    juce::SharedResourcePointer<TraceRecorder> traceRecorder;
+   #endif
+
+    // One mapping of the shared-memory control block per process, however many instances,
+    // and only once one of them has switched GLOBAL on. Attached by the message thread and
+    // kept until the instance goes, so the audio thread's pointer never dangles.
+    std::unique_ptr<juce::SharedResourcePointer<GlobalControls>> globalControlsAttachment;
+    std::atomic<const GlobalControls*> globalControls { nullptr };
+    PerformanceCounters performance;
+    std::array<NoteHistory, numExtraLanes + 1> laneStates;     // one per lane, lane 0 is the main one
+
+    VelocityCurve curve;
+    juce::ChangeBroadcaster curveBroadcaster;
+    juce::SpinLock curveLock;
+    VelocityCurve::Table pendingCurveTable;     // guarded by curveLock
+    bool curveTablePending = false;             // guarded by curveLock
+    VelocityCurve::Table curveTable;            // audio thread only
+
+    // samples processed since prepareToPlay, the timeline used when the host has no playhead
+    juce::int64 samplePosition = 0;
+
+    int sidechainBusIndex = -1;
+    EnvelopeFollower sidechainFollower;     // never prepared, so never allocates, in a MIDI effect
+
+    // The table only exists while FREEZE is on. The message thread swaps tables in and
+    // out under freezeLock, and keeps frozenState in step through the journal, so saving
+    // the state never keeps the audio thread out of the table.
+    static constexpr int freezeCapacity = 1 << 14;
+    static constexpr int freezeJournalSize = 2048;      // one housekeeping tick at 20,000 notes a second
+    juce::SpinLock freezeLock;
+    FreezeCache freezeCache;                            // guarded by freezeLock
+    std::unique_ptr<FreezeJournal> freezeJournal;       // replaced under both locks
+    juce::CriticalSection freezeStateLock;
+    FreezeCache frozenState;                            // guarded by freezeStateLock
+
+    // seeds each block's random stream, so a captured block can be replayed exactly
+    juce::Random liveSeeds { makeInstanceSeed() };
 
+    juce::SpinLock captureLock;
+    std::unique_ptr<CaptureWriter> captureWriter;       // guarded by captureLock
+    bool captureNeedsSnapshot = true;                   // guarded by captureLock
+    std::vector<float> capturedParameterValues;         // sized in the constructor
 
-    int things, offset;
-    int rand;
-    float rate;
-    int time;
-    juce::SortedSet<int> notes;
+    // processBlock's output and each lane's share of it, reserved in prepareToPlay and reused every block
+    static constexpr int minMidiEventsPerBlock = 256;
+    static constexpr size_t midiBytesPerEvent = 4 + 2 + 3;     // MidiBuffer's timestamp and size, then the message
+    juce::MidiBuffer processedMidi;
+    std::array<juce::MidiBuffer, numExtraLanes + 1> laneMidi;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NewProjectAudioProcessor)
 };
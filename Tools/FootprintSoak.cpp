@@ -0,0 +1,169 @@
+/*
+  ==============================================================================
+
+    Checks that an instance's memory stops growing once it has warmed up.
+
+    Plays hours of simulated session through one NewProjectAudioProcessor,
+    as fast as it will run: 512 sample blocks at 48 kHz with a few notes on
+    four channels, over a four minute song that loops so FREEZE keeps meeting
+    the same positions. Housekeeping runs every 100 ms of song time, as the
+    message thread's timer would. Every simulated minute some parameters
+    move and the state is saved and restored, and every hour FREEZE is
+    switched off and on again. With --editor, an editor is also opened and
+    closed every ten minutes.
+
+    Every ten simulated minutes it samples getMemoryFootprint() and, on
+    Linux, the process's resident set from /proc/self/statm. The first
+    quarter of the run is warm-up. After it the footprint must not change at
+    all, and the resident set may not grow by more than 2% or 1 MB, which
+    leaves room for the allocator's own bookkeeping. Exits with 1 otherwise.
+
+    Build it as ToolHost.h describes. --editor needs a display; run it under
+    Xvfb on a headless machine.
+
+    Usage:
+        footprint-soak [simulated hours, default 8] [--editor]
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../PluginProcessor.h"
+#include "../PluginEditor.h"
+#include "ToolHost.h"
+
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr double songSeconds = 4 * 60.0;
+    constexpr int blocksPerSecond = (int) (sampleRate / blockSize);
+    constexpr int blocksPerMinute = 60 * blocksPerSecond;
+
+    struct Sample
+    {
+        int minute = 0;
+        juce::int64 processorBytes = 0, editorBytes = 0, residentBytes = 0;
+    };
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    const auto hours = argc > 1 && juce::String(argv[1]).getDoubleValue() > 0.0 ? juce::String(argv[1]).getDoubleValue() : 8.0;
+    const auto withEditor = juce::StringArray(argv, argc).contains("--editor");
+
+    const auto totalMinutes = juce::jmax(40, juce::roundToInt(hours * 60.0));
+    const auto warmUpMinutes = totalMinutes / 4;
+
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    NewProjectAudioProcessor processor;
+
+    // looping over the song, so positions repeat
+    ToolHost::Transport transport(sampleRate, (juce::int64) (songSeconds * sampleRate));
+
+    processor.setPlayHead(&transport);
+    processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+    processor.prepareToPlay(sampleRate, blockSize);
+
+    *processor.freeze = true;
+    *processor.useGlobalControls = true;
+    processor.runHousekeeping();
+
+    juce::AudioBuffer<float> buffer(juce::jmax(processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels()), blockSize);
+    juce::MidiBuffer midi;
+    juce::MemoryBlock state;
+    juce::Random random(1);
+    juce::int64 blockIndex = 0;
+    juce::int64 editorBytes = 0;
+
+    juce::Array<Sample> samples;
+    const auto start = juce::Time::getMillisecondCounterHiRes();
+
+    std::cout << "minute  footprint bytes  editor bytes  resident bytes" << std::endl;
+
+    for (int minute = 1; minute <= totalMinutes; ++minute)
+    {
+        for (int b = 0; b < blocksPerMinute; ++b, ++blockIndex)
+        {
+            ToolHost::fillBlock(midi, blockIndex, blockSize);
+            buffer.clear();
+            processor.processBlock(buffer, midi);
+            transport.advance(blockSize);
+
+            if (blockIndex % (blocksPerSecond / 10) == 0)
+                processor.runHousekeeping();
+        }
+
+        // a little automation, then a host saving and reloading the session
+        *processor.range = random.nextInt(128);
+        *processor.skew = random.nextInt(6);
+        *processor.direction = random.nextInt(3);
+
+        processor.getStateInformation(state);
+        processor.setStateInformation(state.getData(), (int) state.getSize());
+
+        if (minute % 60 == 30)
+        {
+            *processor.freeze = false;
+            processor.runHousekeeping();
+            *processor.freeze = true;
+            processor.runHousekeeping();
+        }
+
+        if (withEditor && minute % 10 == 5)
+        {
+            std::unique_ptr<juce::AudioProcessorEditor> editor(processor.createEditor());
+            editorBytes = (juce::int64) dynamic_cast<AarrowAudioProcessorEditor&> (*editor).getMemoryFootprint().getTotalBytes();
+        }
+
+        if (minute % 10 == 0)
+        {
+            const Sample sample { minute, (juce::int64) processor.getMemoryFootprint().getTotalBytes(), editorBytes, ToolHost::getResidentBytes() };
+            samples.add(sample);
+
+            std::cout << juce::String(sample.minute).paddedLeft(' ', 6)
+                      << juce::String(sample.processorBytes).paddedLeft(' ', 17)
+                      << juce::String(sample.editorBytes).paddedLeft(' ', 14)
+                      << juce::String(sample.residentBytes).paddedLeft(' ', 16)
+                      << std::endl;
+        }
+    }
+
+    processor.releaseResources();
+    processor.setPlayHead(nullptr);
+
+    // the last sample inside the warm-up is the baseline everything after is held to
+    Sample baseline;
+
+    for (auto& sample : samples)
+        if (sample.minute <= warmUpMinutes)
+            baseline = sample;
+
+    int failures = 0;
+
+    for (auto& sample : samples)
+    {
+        if (sample.minute <= warmUpMinutes)
+            continue;
+
+        const auto residentLimit = baseline.residentBytes + juce::jmax((juce::int64) 1 << 20, baseline.residentBytes / 50);
+
+        if (sample.processorBytes != baseline.processorBytes || sample.editorBytes != baseline.editorBytes
+             || sample.residentBytes > residentLimit)
+        {
+            std::cout << "FAIL  minute " << sample.minute << ": footprint " << baseline.processorBytes << " -> " << sample.processorBytes
+                      << ", editor " << baseline.editorBytes << " -> " << sample.editorBytes
+                      << ", resident " << baseline.residentBytes << " -> " << sample.residentBytes << std::endl;
+            ++failures;
+        }
+    }
+
+    std::cout << totalMinutes << " simulated minutes in " << juce::String((juce::Time::getMillisecondCounterHiRes() - start) / 1000.0, 1)
+              << " s, warm-up " << warmUpMinutes << " minutes; "
+              << (failures == 0 ? "no growth after warm-up" : "memory kept growing") << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+
+    Command line controller for the shared global controls.
+
+    Sets the humanize amount and seed that every instance with GLOBAL switched
+    on picks up at its next block. Build it next to the plugin sources:
+
+        c++ -std=c++17 -O2 -I.. GlobalControl.cpp ../GlobalControls.cpp -o global-control
+
+    (add -lrt on older Linux systems)
+
+    Usage:
+        global-control                        print the current values
+        global-control <amount%> [seed]       amount 0..200 scales RANGE, seed replaces SEED
+        global-control off                    instances fall back to their own parameters
+
+  ==============================================================================
+*/
+
+#include "GlobalControls.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    GlobalControls controls;
+
+    if (! controls.isAttached())
+    {
+        std::fprintf(stderr, "couldn't open the shared control block '%s'\n", GlobalControls::defaultName);
+        return 1;
+    }
+
+    if (argc > 1)
+    {
+        GlobalControls::Values values;
+
+        if (std::strcmp(argv[1], "off") != 0)
+        {
+            values.valid = true;
+            values.amountPercent = std::atoi(argv[1]);
+            values.seed = argc > 2 ? (std::uint32_t) std::strtoul(argv[2], nullptr, 10)
+                                   : controls.read().seed;
+        }
+
+        controls.write(values);
+    }
+
+    const auto current = controls.read();
+
+    if (current.valid)
+        std::printf("amount %d%%, seed %u\n", current.amountPercent, (unsigned) current.seed);
+    else
+        std::printf("off\n");
+
+    return 0;
+}
@@ -0,0 +1,651 @@
+/*
+  ==============================================================================
+
+    Checks the velocity kernels against the distributions documented in
+    VelocityKernels.h, and measures their throughput.
+
+    For every RANGE 0..127 and INTENSITY 0..5 it draws the random offsets the
+    way the plugin's FIXED SEED mode does, and again the way its live mode
+    does, from one juce::Random stream per block. It compares both with the
+    exact target distribution, using a chi-square goodness of fit test and a
+    Kolmogorov-Smirnov distance, and checks that INTENSITY 5 never gives
+    anything but 0 or RANGE. Then it plays every RANGE, INTENSITY, DIRECTION
+    and BASE combination over the whole range of input and base velocities,
+    through the same getNoteOnBase() and varyNoteOn() as the plugin with a
+    note history, plainly and with NO REPEAT, CHORDS and FAST REPEATS and the
+    offline tier, from both kinds of stream, and checks that every output is
+    a valid note-on velocity, 1..127. Then it times each of the compiled
+    kernels. Last, it plays dense blocks through the block loop picked from
+    the KernelTable once per block, and through the branchy loop it replaced,
+    which read the modes from the parameters and branched on them for every
+    note. Both must give the same velocities; it prints how much faster the
+    specialised one is.
+
+    The live streams come from LiveRandom below, a copy of juce::Random's
+    generator that gives the same numbers for the same seed.
+
+    Exits with 1 if any check fails. Free of JUCE; build it next to the
+    plugin sources:
+
+        c++ -std=c++17 -O2 -I.. KernelStats.cpp -o kernel-stats
+
+    Usage:
+        kernel-stats [draws per setting, default 20000]
+
+  ==============================================================================
+*/
+
+#include "VelocityEngine.h"
+#include "CounterRandom.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+//==============================================================================
+namespace
+{
+    constexpr double minimumPValue = 1.0e-6;    // ~770 tests, so a false alarm stays below 1 in 1000
+    constexpr double ksCoefficient = 1.95;      // alpha 0.001; conservative for discrete distributions
+
+    // The exact distribution of getRandomOffset() for one RANGE and INTENSITY, over 0..range
+    std::vector<double> getTargetDistribution(int range, int skew)
+    {
+        std::vector<double> p((size_t) range + 1, 0.0);
+        const auto firstDraws = range > 0 ? range : 1;
+
+        for (int i = 0; i < firstDraws; ++i)
+            p[(size_t) i] = 1.0 / firstDraws;
+
+        if (getSkewClass(skew) == SkewClass::extremes)
+        {
+            std::fill(p.begin(), p.end(), 0.0);
+            p[0] += 0.5;
+            p[(size_t) range] += 0.5;
+        }
+        else if (getSkewClass(skew) == SkewClass::stacked)
+        {
+            const auto stackedDraws = range / 5 > 0 ? range / 5 : 1;
+
+            for (int x = 0; x < skew; ++x)
+            {
+                std::vector<double> next(p.size(), 0.0);
+
+                for (int value = 0; value <= range; ++value)
+                    for (int d = 0; d < stackedDraws; ++d)
+                        next[(size_t) std::min(value + d, range)] += p[(size_t) value] / stackedDraws;
+
+                p.swap(next);
+            }
+        }
+
+        return p;
+    }
+
+    // Upper tail of the chi-square distribution: the regularised incomplete gamma Q(df/2, x/2)
+    double getChiSquarePValue(double chiSquare, int degreesOfFreedom)
+    {
+        const auto a = 0.5 * degreesOfFreedom;
+        const auto x = 0.5 * chiSquare;
+
+        if (x <= 0.0)
+            return 1.0;
+
+        const auto logPrefix = a * std::log(x) - x - std::lgamma(a);
+
+        if (x < a + 1.0)
+        {
+            // series for P, then Q = 1 - P
+            auto term = 1.0 / a, sum = term;
+
+            for (int n = 1; n < 1000 && std::abs(term) > std::abs(sum) * 1.0e-15; ++n)
+                sum += (term *= x / (a + n));
+
+            return 1.0 - sum * std::exp(logPrefix);
+        }
+
+        // Lentz's continued fraction for Q
+        auto b = x + 1.0 - a, c = 1.0e300, d = 1.0 / b, h = d;
+
+        for (int n = 1; n < 1000; ++n)
+        {
+            const auto an = -n * (n - a);
+            b += 2.0;
+            d = an * d + b;
+            c = b + an / c;
+            d = 1.0 / (std::abs(d) < 1.0e-300 ? 1.0e-300 : d);
+            const auto delta = d * c;
+            h *= delta;
+
+            if (std::abs(delta - 1.0) < 1.0e-15)
+                break;
+        }
+
+        return std::exp(logPrefix) * h;
+    }
+
+    struct FitResult
+    {
+        double pValue = 1.0;
+        double ksDistance = 0.0;
+        int degreesOfFreedom = 0;
+    };
+
+    FitResult testFit(const std::vector<long>& counts, const std::vector<double>& target, long numDraws)
+    {
+        FitResult result;
+
+        // chi-square, merging neighbouring bins until each expects at least 5 draws
+        double chiSquare = 0.0, observed = 0.0, expected = 0.0;
+        int numBins = 0;
+
+        for (size_t k = 0; k < target.size(); ++k)
+        {
+            observed += (double) counts[k];
+            expected += target[k] * (double) numDraws;
+
+            if (expected >= 5.0 || k + 1 == target.size())
+            {
+                if (expected > 0.0)
+                {
+                    chiSquare += (observed - expected) * (observed - expected) / expected;
+                    ++numBins;
+                }
+                else if (observed > 0.0)
+                {
+                    chiSquare = INFINITY;     // a value the target says can't happen
+                }
+
+                observed = expected = 0.0;
+            }
+        }
+
+        result.degreesOfFreedom = numBins - 1;
+
+        if (result.degreesOfFreedom > 0 || std::isinf(chiSquare))
+            result.pValue = std::isinf(chiSquare) ? 0.0 : getChiSquarePValue(chiSquare, result.degreesOfFreedom);
+
+        // Kolmogorov-Smirnov distance between the empirical and target CDFs
+        double empirical = 0.0, cumulative = 0.0;
+
+        for (size_t k = 0; k < target.size(); ++k)
+        {
+            empirical += (double) counts[k] / (double) numDraws;
+            cumulative += target[k];
+            result.ksDistance = std::max(result.ksDistance, std::abs(empirical - cumulative));
+        }
+
+        return result;
+    }
+
+    //==============================================================================
+    // juce::Random's generator, the 48 bit linear congruential one java.util.Random
+    // uses, so the live path can be checked without JUCE. Same seed, same numbers.
+    struct LiveRandom
+    {
+        explicit LiveRandom(std::int64_t seedValue) noexcept  : seed(seedValue) {}
+
+        int nextInt() noexcept
+        {
+            seed = (std::int64_t) (((std::uint64_t) seed * 0x5deece66dull + 11) & 0xffffffffffffull);
+            return (int) (seed >> 16);
+        }
+
+        int nextInt(int maxValue) noexcept
+        {
+            return (int) (((std::uint64_t) (unsigned int) nextInt() * (std::uint64_t) maxValue) >> 32);
+        }
+
+        std::int64_t nextInt64() noexcept
+        {
+            const auto high = (std::uint64_t) (unsigned int) nextInt();
+            return (std::int64_t) ((high << 32) | (std::uint64_t) (unsigned int) nextInt());
+        }
+
+        std::int64_t seed;
+    };
+
+    // The plugin's live mode: a new stream every block, seeded from the instance's
+    // sequence of block seeds, with the block's notes drawing from it in turn
+    struct LiveStreams
+    {
+        static constexpr int notesPerBlock = 8;
+
+        LiveRandom& next() noexcept
+        {
+            if (notesInBlock++ % notesPerBlock == 0)
+                block = LiveRandom(blockSeeds.nextInt64());
+
+            return block;
+        }
+
+        LiveRandom blockSeeds { 0x5eed };
+        LiveRandom block { 0 };
+        long notesInBlock = 0;
+    };
+
+    template <typename RandomType>
+    int drawOffset(const VelocitySettings& s, RandomType& random)
+    {
+        switch (getSkewClass(s.skew))
+        {
+            case SkewClass::flat:       return getRandomOffset<SkewClass::flat>(s, random);
+            case SkewClass::stacked:    return getRandomOffset<SkewClass::stacked>(s, random);
+            case SkewClass::extremes:   return getRandomOffset<SkewClass::extremes>(s, random);
+        }
+
+        return -1;
+    }
+
+    // Fits drawsPerSetting offsets from drawOffset(settings, draw) against the target for
+    // every RANGE and INTENSITY, and returns the number of settings that failed
+    template <typename DrawOffset>
+    int checkOffsets(const char* streamName, long drawsPerSetting, DrawOffset&& drawOffset)
+    {
+        double worstPValue = 1.0, worstKsRatio = 0.0;
+        int failures = 0;
+
+        for (int range = 0; range <= 127; ++range)
+        {
+            for (int skew = 0; skew <= 5; ++skew)
+            {
+                VelocitySettings s;
+                s.range = range;
+                s.skew = skew;
+
+                const auto target = getTargetDistribution(range, skew);
+                std::vector<long> counts(target.size(), 0);
+                bool outOfRange = false;
+
+                for (long draw = 0; draw < drawsPerSetting; ++draw)
+                {
+                    const auto offset = drawOffset(s, draw);
+
+                    if (offset < 0 || offset > range || (skew == 5 && offset != 0 && offset != range))
+                        outOfRange = true;
+                    else
+                        ++counts[(size_t) offset];
+                }
+
+                const auto fit = testFit(counts, target, drawsPerSetting);
+                const auto ksLimit = ksCoefficient / std::sqrt((double) drawsPerSetting);
+
+                worstPValue = std::min(worstPValue, fit.pValue);
+                worstKsRatio = std::max(worstKsRatio, fit.ksDistance / ksLimit);
+
+                if (outOfRange || fit.pValue < minimumPValue || fit.ksDistance > ksLimit)
+                {
+                    std::printf("FAIL  %s RANGE %d INTENSITY %d: %schi-square p %.3g (%d df), KS %.4f (limit %.4f)\n",
+                                streamName, range, skew, outOfRange ? "offset outside the documented values, " : "",
+                                fit.pValue, fit.degreesOfFreedom, fit.ksDistance, ksLimit);
+                    ++failures;
+                }
+            }
+        }
+
+        std::printf("offsets, %s: 768 RANGE/INTENSITY settings x %ld draws, lowest chi-square p %.3g, worst KS at %.0f%% of its limit\n",
+                    streamName, drawsPerSetting, worstPValue, 100.0 * worstKsRatio);
+
+        return failures;
+    }
+
+    //==============================================================================
+    // one note through a whole kernel, like the plugin's stream 0: its base from the
+    // note history, then its variation
+    template <BaseMode baseMode, VariationDirection direction, SkewClass skewClass, typename RandomType>
+    int varyNote(NoteHistory& history, const NoteOptions& options, int noteNumber, int inputVelocity,
+                 std::int64_t position, const VelocitySettings& s, RandomType& random) noexcept
+    {
+        auto settings = s;
+        const auto velocity = getNoteOnBase<baseMode, direction>(history, options, noteNumber, 0, inputVelocity, position, settings);
+
+        return clampVelocity(varyNoteOn<direction, skewClass>(history, options, noteNumber, velocity, position, settings, random));
+    }
+
+    template <typename RandomType>
+    struct NoteKernels
+    {
+        using Kernel = int (*)(NoteHistory&, const NoteOptions&, int, int, std::int64_t, const VelocitySettings&, RandomType&);
+
+        template <BaseMode baseMode, VariationDirection direction, SkewClass skewClass>
+        struct Of
+        {
+            static constexpr Kernel value = &varyNote<baseMode, direction, skewClass, RandomType>;
+        };
+
+        static Kernel get(BaseMode baseMode, VariationDirection direction, SkewClass skewClass) noexcept
+        {
+            return KernelTable<Of>::get(baseMode, direction, skewClass);
+        }
+    };
+
+    // the note options the bounds pass plays with, at 48 kHz
+    NoteOptions getOptions(int index) noexcept
+    {
+        NoteOptions options;
+        options.fastInterval = 12000;
+
+        switch (index)
+        {
+            case 1:     options.antiRepeat = true; break;
+            case 2:     options.chords = true; options.chordWindow = 480; options.chordSpread = 3; options.repetitionAmount = 100; break;
+            case 3:     options.offlineQuality = true; break;
+            default:    break;
+        }
+
+        return options;
+    }
+
+    //==============================================================================
+    // A dense block of note-ons through one specialisation, the shape of the plugin's
+    // processEvents() without the history: one kernel for the whole block
+    using BlockKernel = long (*)(const unsigned char*, unsigned char*, int, std::int64_t, const VelocitySettings&, std::uint64_t);
+
+    template <BaseMode baseMode, VariationDirection direction, SkewClass skewClass>
+    long varyBlock(const unsigned char* input, unsigned char* output, int numNotes, std::int64_t blockStart,
+                   const VelocitySettings& s, std::uint64_t seed) noexcept
+    {
+        long sum = 0;
+
+        for (int i = 0; i < numNotes; ++i)
+        {
+            CounterRandom random(seed, blockStart + i, 60, 1);
+            output[i] = (unsigned char) clampVelocity(getVariedVelocity<direction, skewClass>(getBaseVelocity<baseMode>(input[i], s), s, random));
+            sum += output[i];
+        }
+
+        return sum;
+    }
+
+    template <BaseMode baseMode, VariationDirection direction, SkewClass skewClass>
+    struct BlockKernelOf
+    {
+        static constexpr BlockKernel value = &varyBlock<baseMode, direction, skewClass>;
+    };
+
+    // The parameters the old loop read for every note
+    struct LiveParameters
+    {
+        std::atomic<int> range { 0 }, skew { 0 }, baseValue { 0 }, useBaseValue { 0 }, direction { 0 };
+        const unsigned char* curve = nullptr;
+    };
+
+    // The same block the way the loop was written before the kernels: every note reads the
+    // parameters and branches on BASE, INTENSITY and DIRECTION. Draws in the same order.
+    long varyBlockBranchy(const unsigned char* input, unsigned char* output, int numNotes, std::int64_t blockStart,
+                          const LiveParameters& p, std::uint64_t seed) noexcept
+    {
+        long sum = 0;
+
+        for (int i = 0; i < numNotes; ++i)
+        {
+            CounterRandom random(seed, blockStart + i, 60, 1);
+            auto velocity = p.useBaseValue.load(std::memory_order_relaxed) != 0 ? p.baseValue.load(std::memory_order_relaxed)
+                                                                                : (int) p.curve[input[i] & 127];
+
+            const auto range = p.range.load(std::memory_order_relaxed);
+            auto rand = nextIntBelow(random, range);
+
+            if (p.skew.load(std::memory_order_relaxed) == 5)
+            {
+                rand = (random.nextInt(2) == 0) ? 0 : range;
+            }
+            else
+            {
+                for (int x = 0; x < p.skew.load(std::memory_order_relaxed); x++)
+                    rand = std::min(p.range.load(std::memory_order_relaxed), rand + nextIntBelow(random, p.range.load(std::memory_order_relaxed) / 5));
+            }
+
+            switch (p.direction.load(std::memory_order_relaxed))
+            {
+                case 0:     velocity += rand; break;
+                case 1:     velocity -= p.range.load(std::memory_order_relaxed) / 2; velocity += rand; break;
+                case 2:     velocity -= rand; break;
+                default:    velocity += 1; break;
+            }
+
+            output[i] = (unsigned char) clampVelocity(velocity);
+            sum += output[i];
+        }
+
+        return sum;
+    }
+
+    constexpr int numOptionSets = 4;
+    const char* const optionNames[]    = { "plain", "NO REPEAT", "CHORDS and FAST REPEATS", "offline" };
+    const char* const baseNames[]      = { "AUTO", "BASE VALUE", "ADAPTIVE" };
+    const char* const directionNames[] = { "Up", "Centred", "Down" };
+
+    // Plays every combination through the kernels for one kind of stream, nextRandom(position, note)
+    // giving each note's. Returns the number of outputs outside 1..127.
+    template <typename RandomType, typename NextRandom>
+    long checkBounds(const char* streamName, const unsigned char* curve, NextRandom&& nextRandom, long& notesChecked)
+    {
+        long invalid = 0;
+        NoteHistory history;
+
+        for (int optionSet = 0; optionSet < numOptionSets; ++optionSet)
+        {
+            const auto options = getOptions(optionSet);
+
+            for (int baseMode = 0; baseMode < 3; ++baseMode)
+            {
+                for (int direction = 0; direction < 3; ++direction)
+                {
+                    for (int skew = 0; skew <= 5; ++skew)
+                    {
+                        const auto kernel = NoteKernels<RandomType>::get((BaseMode) baseMode, (VariationDirection) direction, getSkewClass(skew));
+
+                        for (int range = 0; range <= 127; ++range)
+                        {
+                            // a fresh start for every setting, then a phrase long enough for ADAPTIVE to settle
+                            history.reset();
+                            std::int64_t position = 0;
+
+                            for (int velocity = 1; velocity <= 127; ++velocity)
+                            {
+                                VelocitySettings s;
+                                s.range = range;
+                                s.skew = skew;
+                                s.baseValue = velocity;
+                                s.curve = curve;
+
+                                for (int draw = 0; draw < 4; ++draw, ++notesChecked, position += 100)
+                                {
+                                    const auto noteNumber = 48 + (velocity + draw) % 24;
+                                    auto& random = nextRandom(position, noteNumber);
+                                    const auto output = kernel(history, options, noteNumber, velocity, position, s, random);
+
+                                    if (output < 1 || output > 127)
+                                    {
+                                        if (invalid++ < 10)
+                                            std::printf("FAIL  %s %s %s %s RANGE %d INTENSITY %d velocity %d gave %d\n", streamName,
+                                                        optionNames[optionSet], baseNames[baseMode], directionNames[direction],
+                                                        range, skew, velocity, output);
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        return invalid;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    const long drawsPerSetting = argc > 1 ? std::max(1000L, std::atol(argv[1])) : 20000L;
+    int failures = 0;
+
+    std::array<unsigned char, 128> identityCurve;
+
+    for (int v = 0; v < 128; ++v)
+        identityCurve[(size_t) v] = (unsigned char) clampVelocity(v);
+
+    // 1. the offset distributions, from FIXED SEED streams and from live ones
+    failures += checkOffsets("FIXED SEED", drawsPerSetting, [] (const VelocitySettings& s, long draw)
+    {
+        CounterRandom random(12345, draw, 60, 1);
+        return drawOffset(s, random);
+    });
+
+    LiveStreams liveStreams;
+
+    failures += checkOffsets("live", drawsPerSetting, [&] (const VelocitySettings& s, long)
+    {
+        return drawOffset(s, liveStreams.next());
+    });
+
+    // 2. every output a valid note-on velocity, in every combination
+    long notesChecked = 0;
+    CounterRandom fixedRandom(0, 0, 0, 0);
+
+    auto nextFixed = [&] (std::int64_t position, int noteNumber) -> CounterRandom&
+    {
+        fixedRandom = CounterRandom(777, position, noteNumber, 1);
+        return fixedRandom;
+    };
+
+    auto nextLive = [&] (std::int64_t, int) -> LiveRandom&  { return liveStreams.next(); };
+
+    const auto invalid = checkBounds<CounterRandom>("FIXED SEED", identityCurve.data(), nextFixed, notesChecked)
+                       + checkBounds<LiveRandom>("live", identityCurve.data(), nextLive, notesChecked);
+
+    if (invalid > 0)
+        ++failures;
+
+    std::printf("bounds: %ld notes over every option set, BASE, DIRECTION, INTENSITY, RANGE and velocity, from both streams, %ld outside 1..127\n",
+                notesChecked, invalid);
+
+    // 3. throughput of each compiled kernel, at RANGE 20
+    constexpr long notesPerKernel = 2000000;
+    volatile int sink = 0;
+
+    NoteHistory history;
+    const NoteOptions plain;
+
+    std::printf("throughput, million notes/s with a fresh FIXED SEED stream per note:\n");
+
+    for (int baseMode = 0; baseMode < 3; ++baseMode)
+    {
+        std::printf("  %-10s", baseNames[baseMode]);
+
+        for (int direction = 0; direction < 3; ++direction)
+        {
+            for (const auto skew : { 0, 3, 5 })
+            {
+                const auto kernel = NoteKernels<CounterRandom>::get((BaseMode) baseMode, (VariationDirection) direction, getSkewClass(skew));
+
+                VelocitySettings s;
+                s.range = 20;
+                s.skew = skew;
+                s.baseValue = 84;
+                s.curve = identityCurve.data();
+
+                int sum = 0;
+                history.reset();
+                const auto start = std::chrono::steady_clock::now();
+
+                for (long note = 0; note < notesPerKernel; ++note)
+                {
+                    CounterRandom random(99, note, (int) (note & 127), 1);
+                    sum += kernel(history, plain, (int) (note & 127), 1 + (int) (note % 127), note * 100, s, random);
+                }
+
+                const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                sink = sink + sum;
+
+                std::printf(" %s/%d %6.1f", directionNames[direction], skew, notesPerKernel / seconds * 1.0e-6);
+            }
+        }
+
+        std::printf("\n");
+    }
+
+    // 4. dense blocks, one kernel picked per block against per-note branches
+    constexpr int notesPerBlock = 512;
+    constexpr long blocksPerSetting = 4000;
+
+    std::array<unsigned char, notesPerBlock> blockInput, specialisedOutput, branchyOutput;
+
+    for (int i = 0; i < notesPerBlock; ++i)
+        blockInput[(size_t) i] = (unsigned char) (1 + (i * 37) % 127);
+
+    struct DenseSetting { int base, direction, skew; };
+    long mismatches = 0;
+
+    std::printf("dense blocks of %d note-ons, million notes/s, kernel per block against per-note branches:\n", notesPerBlock);
+
+    for (const auto setting : { DenseSetting { 0, 0, 1 }, DenseSetting { 0, 1, 0 }, DenseSetting { 1, 2, 3 }, DenseSetting { 0, 0, 5 } })
+    {
+        VelocitySettings s;
+        s.range = 20;
+        s.skew = setting.skew;
+        s.baseValue = 84;
+        s.curve = identityCurve.data();
+
+        LiveParameters parameters;
+        parameters.range = s.range;
+        parameters.skew = s.skew;
+        parameters.baseValue = s.baseValue;
+        parameters.useBaseValue = setting.base;
+        parameters.direction = setting.direction;
+        parameters.curve = s.curve;
+
+        // the best of a few runs, so a stray interruption doesn't decide the comparison
+        const auto timeBlocks = [&] (auto&& processOneBlock)
+        {
+            double bestSeconds = 1.0e9;
+
+            for (int run = 0; run < 3; ++run)
+            {
+                long sum = 0;
+                const auto start = std::chrono::steady_clock::now();
+
+                for (long block = 0; block < blocksPerSetting; ++block)
+                    sum += processOneBlock(block * notesPerBlock);
+
+                sink = sink + (int) sum;
+                bestSeconds = std::min(bestSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+
+            return blocksPerSetting * notesPerBlock / bestSeconds * 1.0e-6;
+        };
+
+        const auto specialisedRate = timeBlocks([&] (std::int64_t blockStart)
+        {
+            const auto kernel = KernelTable<BlockKernelOf>::get((BaseMode) setting.base, (VariationDirection) setting.direction, getSkewClass(s.skew));
+            return kernel(blockInput.data(), specialisedOutput.data(), notesPerBlock, blockStart, s, 42);
+        });
+
+        const auto branchyRate = timeBlocks([&] (std::int64_t blockStart)
+        {
+            return varyBlockBranchy(blockInput.data(), branchyOutput.data(), notesPerBlock, blockStart, parameters, 42);
+        });
+
+        // the last block of each should agree note for note
+        for (int i = 0; i < notesPerBlock; ++i)
+            if (specialisedOutput[(size_t) i] != branchyOutput[(size_t) i])
+                ++mismatches;
+
+        std::printf("  %-10s %-7s INTENSITY %d  %6.1f against %6.1f, %.2fx\n", baseNames[setting.base], directionNames[setting.direction],
+                    setting.skew, specialisedRate, branchyRate, specialisedRate / branchyRate);
+    }
+
+    if (mismatches > 0)
+    {
+        std::printf("FAIL  the specialised and branchy loops gave %ld different velocities\n", mismatches);
+        ++failures;
+    }
+
+    std::printf("%s\n", failures == 0 ? "all checks passed" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
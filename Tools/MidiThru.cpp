@@ -0,0 +1,356 @@
+/*
+  ==============================================================================
+
+    Standalone MIDI-thru humanizer for live rigs, over the ALSA sequencer.
+
+    Creates a virtual "in" and "out" port and runs every note-on through the
+    same velocity kernels as the plugin, one event at a time, so there is no
+    audio block between a key press and the varied note. The thru thread is
+    memory locked, asks for SCHED_FIFO priority, and sends each event on as
+    soon as it has read it, from a copy on its own stack.
+
+    Linux only. Build it next to the plugin sources:
+
+        c++ -std=c++17 -O2 -I.. MidiThru.cpp -lasound -pthread -o midi-thru
+
+    Usage:
+        midi-thru [options]                  run until Ctrl-C, connect with aconnect
+        midi-thru --latency-test [count]     loop back through virtual ports, report p50/p99
+
+    Options:
+        --range N        0..127, default 10
+        --intensity N    0..5, default 1
+        --direction D    up, centred or down, default up
+        --base N         fixed base velocity instead of the incoming one
+        --seed N         seed for the variation, default 0
+
+  ==============================================================================
+*/
+
+#include "VelocityEngine.h"
+#include "CounterRandom.h"
+
+#include <alsa/asoundlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+//==============================================================================
+struct Options
+{
+    int range = 10;
+    int intensity = 1;
+    VariationDirection direction = VariationDirection::up;
+    int baseValue = -1;     // -1 keeps the incoming velocity
+    std::uint64_t seed = 0;
+
+    bool latencyTest = false;
+    int latencyTestCount = 1000;
+};
+
+//==============================================================================
+class MidiThru
+{
+public:
+    explicit MidiThru(const Options& options)
+        : kernel(KernelTable<HumanizeKernel>::get(options.baseValue >= 0 ? BaseMode::fixed : BaseMode::input,
+                                                  options.direction, getSkewClass(options.intensity))),
+          seed(options.seed)
+    {
+        for (int v = 0; v < 128; ++v)
+            identityCurve[(size_t) v] = (unsigned char) clampVelocity(v);
+
+        settings.range = options.range < 0 ? 0 : (options.range > 127 ? 127 : options.range);
+        settings.skew = options.intensity < 0 ? 0 : (options.intensity > 5 ? 5 : options.intensity);
+        settings.baseValue = options.baseValue;
+        settings.curve = identityCurve.data();
+    }
+
+    ~MidiThru()
+    {
+        if (seq != nullptr)
+            snd_seq_close(seq);
+    }
+
+    bool open(const char* clientName)
+    {
+        if (snd_seq_open(&seq, "default", SND_SEQ_OPEN_DUPLEX, SND_SEQ_NONBLOCK) < 0)
+            return false;
+
+        snd_seq_set_client_name(seq, clientName);
+
+        inputPort = snd_seq_create_simple_port(seq, "in", SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+                                               SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+        outputPort = snd_seq_create_simple_port(seq, "out", SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+                                                SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+
+        return inputPort >= 0 && outputPort >= 0;
+    }
+
+    int getClient() const           { return snd_seq_client_id(seq); }
+    int getInputPort() const        { return inputPort; }
+    int getOutputPort() const       { return outputPort; }
+
+    // Blocks until keepRunning goes false, checking it at least every pollTimeoutMs
+    void run(const std::atomic<bool>& keepRunning)
+    {
+        promoteToRealtime();
+
+        pollfd fds[8];
+        const auto numFds = snd_seq_poll_descriptors(seq, fds, (unsigned int) std::size(fds), POLLIN);
+
+        while (keepRunning.load(std::memory_order_relaxed))
+        {
+            if (poll(fds, (nfds_t) numFds, pollTimeoutMs) <= 0)
+                continue;
+
+            // each event goes out before the next is read: a sysex's data lives in ALSA's
+            // input buffer, which the next read reuses
+            snd_seq_event_t* event = nullptr;
+
+            while (snd_seq_event_input(seq, &event) >= 0 && event != nullptr)
+            {
+                snd_seq_event_t out;
+                process(*event, out);
+                snd_seq_event_output_direct(seq, &out);
+            }
+        }
+    }
+
+private:
+    static constexpr int pollTimeoutMs = 100;
+
+    using Kernel = int (*)(int, const VelocitySettings&, CounterRandom&);
+
+    template <BaseMode baseMode, VariationDirection direction, SkewClass skewClass>
+    static int humanize(int inputVelocity, const VelocitySettings& s, CounterRandom& random) noexcept
+    {
+        return clampVelocity(getVariedVelocity<direction, skewClass>(getBaseVelocity<baseMode>(inputVelocity, s), s, random));
+    }
+
+    template <BaseMode baseMode, VariationDirection direction, SkewClass skewClass>
+    struct HumanizeKernel
+    {
+        static constexpr Kernel value = &humanize<baseMode, direction, skewClass>;
+    };
+
+    //==============================================================================
+    void process(const snd_seq_event_t& in, snd_seq_event_t& out) noexcept
+    {
+        out = in;
+
+        if (in.type == SND_SEQ_EVENT_NOTEON && in.data.note.velocity != 0)
+        {
+            CounterRandom random(seed, eventCounter++, in.data.note.note, in.data.note.channel + 1);
+            out.data.note.velocity = (unsigned char) kernel(in.data.note.velocity & 0x7f, settings, random);
+        }
+
+        snd_seq_ev_set_source(&out, outputPort);
+        snd_seq_ev_set_subs(&out);
+        snd_seq_ev_set_direct(&out);
+    }
+
+    static void promoteToRealtime()
+    {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+            std::fprintf(stderr, "warning: couldn't lock memory, page faults may add latency\n");
+
+        sched_param param {};
+        param.sched_priority = sched_get_priority_max(SCHED_FIFO) / 2;
+
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0)
+            std::fprintf(stderr, "warning: no real-time priority (check rtprio in /etc/security/limits.conf)\n");
+    }
+
+    //==============================================================================
+    snd_seq_t* seq = nullptr;
+    int inputPort = -1, outputPort = -1;
+
+    const Kernel kernel;
+    VelocitySettings settings;
+    std::array<unsigned char, 128> identityCurve;
+
+    std::uint64_t seed = 0;
+    std::int64_t eventCounter = 0;
+};
+
+//==============================================================================
+static std::int64_t getMonotonicNs() noexcept
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (std::int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Ping-pongs note-ons through a second client connected to the thru ports and
+// reports the round trip, which is all software: no hardware ports are involved.
+// Each ping's channel and note carry its sequence number, which the thru passes on
+// unchanged, so a reply that turns up after its ping timed out is never taken for
+// the next one's.
+static int runLatencyTest(MidiThru& thru, int count)
+{
+    std::atomic<bool> keepRunning { true };
+    std::thread thruThread([&] { thru.run(keepRunning); });
+
+    snd_seq_t* seq = nullptr;
+    int result = 1;
+
+    if (snd_seq_open(&seq, "default", SND_SEQ_OPEN_DUPLEX, SND_SEQ_NONBLOCK) >= 0)
+    {
+        snd_seq_set_client_name(seq, "MIDI Velocity Variation latency test");
+
+        const auto out = snd_seq_create_simple_port(seq, "out", SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+                                                    SND_SEQ_PORT_TYPE_APPLICATION);
+        const auto in = snd_seq_create_simple_port(seq, "in", SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+                                                   SND_SEQ_PORT_TYPE_APPLICATION);
+
+        if (out >= 0 && in >= 0
+             && snd_seq_connect_to(seq, out, thru.getClient(), thru.getInputPort()) >= 0
+             && snd_seq_connect_from(seq, in, thru.getClient(), thru.getOutputPort()) >= 0)
+        {
+            pollfd fds[8];
+            const auto numFds = snd_seq_poll_descriptors(seq, fds, (unsigned int) std::size(fds), POLLIN);
+
+            constexpr int numTags = 16 * 128;
+            constexpr std::int64_t timeoutNs = 1000000000;
+
+            std::vector<double> latenciesUs;
+            latenciesUs.reserve((size_t) count);
+            int lost = 0;
+
+            for (int i = 0; i < count; ++i)
+            {
+                const auto tag = i % numTags;
+
+                snd_seq_event_t event;
+                snd_seq_ev_clear(&event);
+                snd_seq_ev_set_source(&event, out);
+                snd_seq_ev_set_subs(&event);
+                snd_seq_ev_set_direct(&event);
+                snd_seq_ev_set_noteon(&event, tag / 128, tag % 128, 100);
+
+                const auto sent = getMonotonicNs();
+                snd_seq_event_output_direct(seq, &event);
+
+                // anything else that arrives is a late reply to an earlier ping, and is dropped
+                auto answered = false;
+
+                for (std::int64_t waitedNs = 0; ! answered && waitedNs < timeoutNs; waitedNs = getMonotonicNs() - sent)
+                {
+                    if (poll(fds, (nfds_t) numFds, (int) ((timeoutNs - waitedNs) / 1000000) + 1) <= 0)
+                        break;
+
+                    snd_seq_event_t* reply = nullptr;
+
+                    while (! answered && snd_seq_event_input(seq, &reply) >= 0 && reply != nullptr)
+                    {
+                        if (reply->type == SND_SEQ_EVENT_NOTEON && reply->data.note.channel * 128 + reply->data.note.note == tag)
+                        {
+                            latenciesUs.push_back((double) (getMonotonicNs() - sent) * 1.0e-3);
+                            answered = true;
+                        }
+                    }
+                }
+
+                if (! answered)
+                    ++lost;
+            }
+
+            if (! latenciesUs.empty())
+            {
+                std::sort(latenciesUs.begin(), latenciesUs.end());
+                const auto percentile = [&] (double p) { return latenciesUs[(size_t) (p * (double) (latenciesUs.size() - 1))]; };
+
+                std::printf("events: %d, lost: %d\n", count, lost);
+                std::printf("latency (us): p50 %.1f, p99 %.1f, max %.1f\n", percentile(0.5), percentile(0.99), latenciesUs.back());
+                result = lost == 0 ? 0 : 1;
+            }
+        }
+        else
+        {
+            std::fprintf(stderr, "couldn't connect the loopback ports\n");
+        }
+
+        snd_seq_close(seq);
+    }
+
+    keepRunning = false;
+    thruThread.join();
+    return result;
+}
+
+//==============================================================================
+static std::atomic<bool> keepRunning { true };
+
+static bool parseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const auto hasValue = i + 1 < argc;
+        const auto* arg = argv[i];
+
+        if (std::strcmp(arg, "--latency-test") == 0)
+        {
+            options.latencyTest = true;
+
+            if (hasValue && argv[i + 1][0] != '-')
+                options.latencyTestCount = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(arg, "--range") == 0 && hasValue)      options.range = std::atoi(argv[++i]);
+        else if (std::strcmp(arg, "--intensity") == 0 && hasValue)  options.intensity = std::atoi(argv[++i]);
+        else if (std::strcmp(arg, "--base") == 0 && hasValue)       options.baseValue = std::min(127, std::atoi(argv[++i]));
+        else if (std::strcmp(arg, "--seed") == 0 && hasValue)       options.seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(arg, "--direction") == 0 && hasValue)
+        {
+            const auto* d = argv[++i];
+            options.direction = std::strcmp(d, "down") == 0    ? VariationDirection::down
+                              : std::strcmp(d, "centred") == 0 ? VariationDirection::centred
+                                                               : VariationDirection::up;
+        }
+        else
+        {
+            std::fprintf(stderr, "unknown option %s\n", arg);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    if (! parseOptions(argc, argv, options))
+        return 2;
+
+    MidiThru thru(options);
+
+    if (! thru.open("MIDI Velocity Variation"))
+    {
+        std::fprintf(stderr, "couldn't open the ALSA sequencer\n");
+        return 1;
+    }
+
+    if (options.latencyTest)
+        return runLatencyTest(thru, options.latencyTestCount);
+
+    std::signal(SIGINT, [] (int) { keepRunning = false; });
+    std::signal(SIGTERM, [] (int) { keepRunning = false; });
+
+    std::printf("thru on client %d, in port %d, out port %d\n", thru.getClient(), thru.getInputPort(), thru.getOutputPort());
+    thru.run(keepRunning);
+    return 0;
+}
@@ -0,0 +1,223 @@
+/*
+  ==============================================================================
+
+    Python bindings for the velocity variation, so training data can be
+    humanized without going through a DAW.
+
+    vary() rewrites the velocity column of an int64 NumPy array of shape (N, 4),
+    columns (timestamp in samples, note, velocity, channel 0-15), in place.
+    The array is never copied: one with another dtype or a non C-contiguous
+    layout is rejected instead of silently converted, since the results would
+    land in the copy. Values are masked to 7 and 4 bits like MIDI bytes, and
+    rows with velocity 0 are note-offs and are left alone. Batches of more than
+    a few thousand rows run with the GIL released.
+
+    The keyword arguments are the plugin's parameters, with its defaults.
+    NO REPEAT, CHORDS, FAST REPEATS and ADAPTIVE remember earlier notes, so the
+    rows are one stretch of playing from a fresh start, like the plugin from
+    the start of playback, and must be in time order; the array is rejected if
+    its timestamps ever go back while one of those is on. Timestamps count
+    samples at sample_rate, which sets the chord window and what counts as a
+    fast repeat.
+
+    With a seed, every note gets exactly the velocity the plugin's main lane
+    gives it in FIXED SEED mode at the same sample position. The exception is
+    offline_quality: the plugin only renders with that tier when FIXED SEED is
+    off, so with it the distribution matches but the values can't. The
+    sidechain, the lanes and the doubles stay in the plugin. Without a seed
+    each call draws a fresh one, and returns it so the batch can be reproduced.
+
+    Build it next to the plugin sources:
+
+        c++ -std=c++17 -O3 -shared -fPIC $(python3 -m pybind11 --includes) -I.. \
+            PythonBindings.cpp -o midi_velocity_variation$(python3-config --extension-suffix)
+
+    Usage:
+        import numpy as np, midi_velocity_variation as mvv
+        events = np.array([[0, 60, 100, 0], [4800, 64, 100, 0]], dtype=np.int64)
+        seed = mvv.vary(events, range=20, intensity=1, direction="centred", chords=True)
+
+  ==============================================================================
+*/
+
+#include "VelocityEngine.h"
+#include "CounterRandom.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+
+namespace py = pybind11;
+
+//==============================================================================
+namespace
+{
+    constexpr py::ssize_t numColumns = 4;   // timestamp, note, velocity, channel
+    constexpr py::ssize_t minRowsToReleaseGil = 4096;
+
+    using Kernel = void (*)(std::int64_t*, py::ssize_t, const VelocitySettings&, const NoteOptions&, NoteHistory&, std::uint64_t);
+
+    // the whole batch with the modes fixed at compile time, like the plugin's processEvents():
+    // one history for every channel, as the plugin's main lane keeps
+    template <BaseMode baseMode, VariationDirection direction, SkewClass skewClass>
+    void varyRows(std::int64_t* rows, py::ssize_t numRows, const VelocitySettings& s, const NoteOptions& options,
+                  NoteHistory& history, std::uint64_t seed) noexcept
+    {
+        for (py::ssize_t i = 0; i < numRows; ++i)
+        {
+            auto* row = rows + i * numColumns;
+            const auto inputVelocity = (int) (row[2] & 0x7f);
+
+            if (inputVelocity == 0)
+                continue;
+
+            const auto position = row[0];
+            const auto noteNumber = (int) (row[1] & 0x7f);
+            const auto channel = (int) (row[3] & 0x0f);
+
+            auto settings = s;
+            const auto velocity = getNoteOnBase<baseMode, direction>(history, options, noteNumber, channel, inputVelocity, position, settings);
+
+            // the same key as the plugin's stream 0 for this note
+            CounterRandom random(seed, position, noteNumber, channel + 1);
+            row[2] = clampVelocity(varyNoteOn<direction, skewClass>(history, options, noteNumber, velocity, position, settings, random));
+        }
+    }
+
+    template <BaseMode baseMode, VariationDirection direction, SkewClass skewClass>
+    struct RowsKernel
+    {
+        static constexpr Kernel value = &varyRows<baseMode, direction, skewClass>;
+    };
+
+    VariationDirection parseDirection(const std::string& name)
+    {
+        if (name == "up")                               return VariationDirection::up;
+        if (name == "centred" || name == "centered")    return VariationDirection::centred;
+        if (name == "down")                             return VariationDirection::down;
+
+        throw py::value_error("direction must be 'up', 'centred' or 'down'");
+    }
+
+    int clampTo(int value, int low, int high) noexcept
+    {
+        return value < low ? low : (value > high ? high : value);
+    }
+
+    //==============================================================================
+    std::uint64_t vary(py::array_t<std::int64_t, py::array::c_style> events,
+                       int range, int intensity, const std::string& direction,
+                       std::optional<int> baseValue, std::optional<std::uint64_t> seed,
+                       std::optional<py::array_t<std::uint8_t, py::array::c_style>> curve,
+                       bool adaptive, bool noRepeat, bool chords, int chordWindowMs, int chordSpread,
+                       int fastRepeats, bool offlineQuality, double sampleRate)
+    {
+        if (events.ndim() != 2 || events.shape(1) != numColumns)
+            throw py::value_error("events must have shape (N, 4): timestamp, note, velocity, channel");
+
+        if (sampleRate <= 0.0)
+            throw py::value_error("sample_rate must be positive");
+
+        std::array<unsigned char, 128> curveTable;
+
+        if (curve.has_value())
+        {
+            if (curve->ndim() != 1 || curve->shape(0) != 128)
+                throw py::value_error("curve must be 128 uint8 output velocities, one per input velocity");
+
+            for (size_t v = 0; v < curveTable.size(); ++v)
+                curveTable[v] = (unsigned char) clampVelocity(curve->data()[v]);
+        }
+        else
+        {
+            for (size_t v = 0; v < curveTable.size(); ++v)
+                curveTable[v] = (unsigned char) clampVelocity((int) v);
+        }
+
+        VelocitySettings settings;
+        settings.range = clampTo(range, 0, 127);
+        settings.skew = clampTo(intensity, 0, 5);
+        settings.baseValue = clampTo(baseValue.value_or(0), 0, 127);
+        settings.curve = curveTable.data();
+
+        NoteOptions options;
+        options.antiRepeat = noRepeat;
+        options.chords = chords;
+        options.chordWindow = (std::int64_t) (clampTo(chordWindowMs, 0, 50) * 0.001 * sampleRate);
+        options.chordSpread = clampTo(chordSpread, 0, 16);
+        options.repetitionAmount = clampTo(fastRepeats, 0, 100);
+        options.fastInterval = (std::int64_t) (0.25 * sampleRate);     // repeats faster than 1/4 s count as fast
+        options.offlineQuality = offlineQuality;
+
+        const auto baseMode = baseValue.has_value() ? BaseMode::fixed : (adaptive ? BaseMode::adaptive : BaseMode::input);
+        const auto kernel = KernelTable<RowsKernel>::get(baseMode, parseDirection(direction), getSkewClass(settings.skew));
+
+        const auto numRows = events.shape(0);
+        const auto usesHistory = noRepeat || chords || options.repetitionAmount > 0 || baseMode == BaseMode::adaptive;
+
+        if (usesHistory)
+        {
+            const auto* data = events.data();
+
+            for (py::ssize_t i = 1; i < numRows; ++i)
+                if (data[i * numColumns] < data[(i - 1) * numColumns])
+                    throw py::value_error("with no_repeat, chords, fast_repeats or adaptive the rows must be in time order");
+        }
+
+        NoteHistory history;
+        history.reset();
+
+        std::random_device entropy;
+        const auto usedSeed = seed.has_value() ? *seed : ((std::uint64_t) entropy() << 32 | entropy());
+
+        // throws if the array is read-only, before anything is touched
+        auto* rows = events.mutable_data();
+
+        if (numRows >= minRowsToReleaseGil)
+        {
+            const py::gil_scoped_release noGil;
+            kernel(rows, numRows, settings, options, history, usedSeed);
+        }
+        else
+        {
+            kernel(rows, numRows, settings, options, history, usedSeed);
+        }
+
+        return usedSeed;
+    }
+}
+
+//==============================================================================
+PYBIND11_MODULE(midi_velocity_variation, m)
+{
+    m.doc() = "MIDI Velocity Variation's humanizer, over NumPy event arrays";
+
+    m.def("vary", &vary,
+          py::arg("events").noconvert(), py::kw_only(),
+          py::arg("range") = 10,
+          py::arg("intensity") = 1,
+          py::arg("direction") = "up",
+          py::arg("base_value") = py::none(),
+          py::arg("seed") = py::none(),
+          py::arg("curve") = py::none(),
+          py::arg("adaptive") = false,
+          py::arg("no_repeat") = false,
+          py::arg("chords") = false,
+          py::arg("chord_window_ms") = 10,
+          py::arg("chord_spread") = 3,
+          py::arg("fast_repeats") = 0,
+          py::arg("offline_quality") = false,
+          py::arg("sample_rate") = 48000.0,
+          "Varies the note-on velocities of an (N, 4) int64 array in place and returns the seed used.\n\n"
+          "base_value fixes the base velocity like BASE VALUE, None uses the incoming one like AUTO,\n"
+          "or like ADAPTIVE with adaptive=True. curve is the 128 entry velocity transfer curve applied\n"
+          "in AUTO mode. no_repeat, chords (with chord_window_ms and chord_spread), fast_repeats (percent)\n"
+          "and offline_quality are the plugin's NO REPEAT, CHORDS, FAST REPEATS and offline render tier;\n"
+          "timestamps count samples at sample_rate.");
+}
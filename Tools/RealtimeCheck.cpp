@@ -0,0 +1,520 @@
+/*
+  ==============================================================================
+
+    Checks that processBlock never allocates, locks, waits or makes a system
+    call.
+
+    Interposed for the whole program, and counted while the thread running
+    processBlock is inside it:
+      - malloc, calloc, realloc, memalign, aligned_alloc, posix_memalign,
+        valloc, free, and operator new and delete
+      - pthread mutex lock, trylock and timedlock, and rwlock read and write locks
+      - condition variable waits and signals, and semaphore waits and posts
+      - nanosleep, clock_nanosleep, usleep and sched_yield
+      - read, write, pread, pwrite and fsync, and syscall() itself, which is
+        how futexes are reached from outside libc
+
+    Each scenario switches on a different set of features from outside
+    processBlock, then runs a few hundred blocks through it. Every block gets
+    its own random MIDI, of every kind, on every channel and at any position.
+    Up to three parameters are automated just before each block, on the audio
+    thread and inside the counted region, as a host does. The feature
+    switches are left alone until the last scenario, which automates
+    everything. FREEZE and GLOBAL get their tables
+    and mappings from runHousekeeping(), as the message thread would. The seed
+    is printed so a failing run can be repeated. Exits with 1 if any scenario
+    made a single call.
+
+    What it can't see: calls libc makes to itself (a printf reaches the
+    kernel without going through the interposed write), system calls made
+    with inline assembly, page faults on memory touched for the first time,
+    and automation arriving from another thread at the same moment, which
+    ThreadStress.cpp covers.
+
+    Linux with glibc only: the real allocator is reached through its __libc_
+    entry points. Build it as ToolHost.h describes, and link with -rdynamic
+    -ldl so the shared libraries see the interposed functions too. Release
+    and Debug builds are both worth checking, since Debug keeps the jasserts.
+
+    Usage:
+        realtime-check [--trap] [--seed n]      --trap stops in the debugger at the first call
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../PluginProcessor.h"
+#include "ToolHost.h"
+
+#include <cerrno>
+#include <cstdarg>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+
+//==============================================================================
+namespace
+{
+    enum Call { mallocCall, freeCall, newCall, deleteCall, lockCall, waitCall, sleepCall, ioCall, syscallCall, numCalls };
+    const char* const callNames[numCalls] = { "malloc", "free", "new", "delete", "lock", "wait or signal", "sleep or yield", "read or write", "syscall" };
+
+    // static TLS, so reading it never allocates
+    thread_local bool insideProcessBlock = false;
+    int callCounts[numCalls] = {};
+    bool trapOnCall = false;
+
+    inline void noteCall(Call call) noexcept
+    {
+        if (! insideProcessBlock)
+            return;
+
+        ++callCounts[call];
+
+        if (trapOnCall)
+            __builtin_trap();
+    }
+
+    // The next definition of a function, found once. The dynamic linker's own locks aren't
+    // pthread mutexes and dlsym's allocations go to __libc_malloc, so this can't recurse.
+    // pthread_cond_* also have a pre-2.3.2 version that dlsym would pick by default.
+    template <typename Function>
+    Function* getReal(const char* name, const char* version = nullptr) noexcept
+    {
+        if (version != nullptr)
+            if (auto* versioned = dlvsym(RTLD_NEXT, name, version))
+                return reinterpret_cast<Function*> (versioned);
+
+        return reinterpret_cast<Function*> (dlsym(RTLD_NEXT, name));
+    }
+}
+
+extern "C"
+{
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+    void* __libc_memalign(size_t, size_t);
+    void __libc_free(void*);
+
+    void* malloc(size_t size)                   { noteCall(mallocCall); return __libc_malloc(size); }
+    void* calloc(size_t count, size_t size)     { noteCall(mallocCall); return __libc_calloc(count, size); }
+    void* realloc(void* block, size_t size)     { noteCall(mallocCall); return __libc_realloc(block, size); }
+    void* memalign(size_t alignment, size_t size)       { noteCall(mallocCall); return __libc_memalign(alignment, size); }
+    void* aligned_alloc(size_t alignment, size_t size)  { noteCall(mallocCall); return __libc_memalign(alignment, size); }
+    void* valloc(size_t size)                   { noteCall(mallocCall); return __libc_memalign((size_t) sysconf(_SC_PAGESIZE), size); }
+
+    int posix_memalign(void** block, size_t alignment, size_t size)
+    {
+        noteCall(mallocCall);
+        *block = __libc_memalign(alignment, size);
+        return *block != nullptr ? 0 : ENOMEM;
+    }
+
+    void free(void* block)
+    {
+        if (block != nullptr)
+            noteCall(freeCall);
+
+        __libc_free(block);
+    }
+
+    //==============================================================================
+    // Locks, including the ones that never block: taking one at all means sharing with a thread that may hold it
+    int pthread_mutex_lock(pthread_mutex_t* mutex)
+    {
+        static const auto real = getReal<int (pthread_mutex_t*)> ("pthread_mutex_lock");
+        noteCall(lockCall);
+        return real(mutex);
+    }
+
+    int pthread_mutex_trylock(pthread_mutex_t* mutex)
+    {
+        static const auto real = getReal<int (pthread_mutex_t*)> ("pthread_mutex_trylock");
+        noteCall(lockCall);
+        return real(mutex);
+    }
+
+    int pthread_mutex_timedlock(pthread_mutex_t* mutex, const struct timespec* timeout)
+    {
+        static const auto real = getReal<int (pthread_mutex_t*, const struct timespec*)> ("pthread_mutex_timedlock");
+        noteCall(lockCall);
+        return real(mutex, timeout);
+    }
+
+    int pthread_rwlock_rdlock(pthread_rwlock_t* lock)
+    {
+        static const auto real = getReal<int (pthread_rwlock_t*)> ("pthread_rwlock_rdlock");
+        noteCall(lockCall);
+        return real(lock);
+    }
+
+    int pthread_rwlock_wrlock(pthread_rwlock_t* lock)
+    {
+        static const auto real = getReal<int (pthread_rwlock_t*)> ("pthread_rwlock_wrlock");
+        noteCall(lockCall);
+        return real(lock);
+    }
+
+    //==============================================================================
+    // Waiting on another thread, or waking one: both go into the kernel
+    int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex)
+    {
+        static const auto real = getReal<int (pthread_cond_t*, pthread_mutex_t*)> ("pthread_cond_wait", "GLIBC_2.3.2");
+        noteCall(waitCall);
+        return real(condition, mutex);
+    }
+
+    int pthread_cond_timedwait(pthread_cond_t* condition, pthread_mutex_t* mutex, const struct timespec* timeout)
+    {
+        static const auto real = getReal<int (pthread_cond_t*, pthread_mutex_t*, const struct timespec*)> ("pthread_cond_timedwait", "GLIBC_2.3.2");
+        noteCall(waitCall);
+        return real(condition, mutex, timeout);
+    }
+
+    // what std::condition_variable's timed waits use since glibc 2.30
+    int pthread_cond_clockwait(pthread_cond_t* condition, pthread_mutex_t* mutex, clockid_t clock, const struct timespec* timeout)
+    {
+        static const auto real = getReal<int (pthread_cond_t*, pthread_mutex_t*, clockid_t, const struct timespec*)> ("pthread_cond_clockwait");
+        noteCall(waitCall);
+        return real(condition, mutex, clock, timeout);
+    }
+
+    int pthread_cond_signal(pthread_cond_t* condition)
+    {
+        static const auto real = getReal<int (pthread_cond_t*)> ("pthread_cond_signal", "GLIBC_2.3.2");
+        noteCall(waitCall);
+        return real(condition);
+    }
+
+    int pthread_cond_broadcast(pthread_cond_t* condition)
+    {
+        static const auto real = getReal<int (pthread_cond_t*)> ("pthread_cond_broadcast", "GLIBC_2.3.2");
+        noteCall(waitCall);
+        return real(condition);
+    }
+
+    int sem_wait(sem_t* semaphore)
+    {
+        static const auto real = getReal<int (sem_t*)> ("sem_wait");
+        noteCall(waitCall);
+        return real(semaphore);
+    }
+
+    int sem_timedwait(sem_t* semaphore, const struct timespec* timeout)
+    {
+        static const auto real = getReal<int (sem_t*, const struct timespec*)> ("sem_timedwait");
+        noteCall(waitCall);
+        return real(semaphore, timeout);
+    }
+
+    int sem_post(sem_t* semaphore)
+    {
+        static const auto real = getReal<int (sem_t*)> ("sem_post");
+        noteCall(waitCall);
+        return real(semaphore);
+    }
+
+    //==============================================================================
+    int nanosleep(const struct timespec* duration, struct timespec* remaining)
+    {
+        static const auto real = getReal<int (const struct timespec*, struct timespec*)> ("nanosleep");
+        noteCall(sleepCall);
+        return real(duration, remaining);
+    }
+
+    int clock_nanosleep(clockid_t clock, int flags, const struct timespec* duration, struct timespec* remaining)
+    {
+        static const auto real = getReal<int (clockid_t, int, const struct timespec*, struct timespec*)> ("clock_nanosleep");
+        noteCall(sleepCall);
+        return real(clock, flags, duration, remaining);
+    }
+
+    int usleep(useconds_t microseconds)
+    {
+        static const auto real = getReal<int (useconds_t)> ("usleep");
+        noteCall(sleepCall);
+        return real(microseconds);
+    }
+
+    int sched_yield() noexcept
+    {
+        static const auto real = getReal<int()> ("sched_yield");
+        noteCall(sleepCall);
+        return real();
+    }
+
+    //==============================================================================
+    ssize_t read(int fd, void* data, size_t size)
+    {
+        static const auto real = getReal<ssize_t (int, void*, size_t)> ("read");
+        noteCall(ioCall);
+        return real(fd, data, size);
+    }
+
+    ssize_t write(int fd, const void* data, size_t size)
+    {
+        static const auto real = getReal<ssize_t (int, const void*, size_t)> ("write");
+        noteCall(ioCall);
+        return real(fd, data, size);
+    }
+
+    ssize_t pread(int fd, void* data, size_t size, off_t offset)
+    {
+        static const auto real = getReal<ssize_t (int, void*, size_t, off_t)> ("pread");
+        noteCall(ioCall);
+        return real(fd, data, size, offset);
+    }
+
+    ssize_t pwrite(int fd, const void* data, size_t size, off_t offset)
+    {
+        static const auto real = getReal<ssize_t (int, const void*, size_t, off_t)> ("pwrite");
+        noteCall(ioCall);
+        return real(fd, data, size, offset);
+    }
+
+    int fsync(int fd)
+    {
+        static const auto real = getReal<int (int)> ("fsync");
+        noteCall(ioCall);
+        return real(fd);
+    }
+
+    // the raw way in, which is how futexes are reached from outside libc. Every system
+    // call takes at most six arguments, so passing six on is always enough.
+    long syscall(long number, ...) noexcept
+    {
+        static const auto real = getReal<long (long, ...)> ("syscall");
+
+        va_list args;
+        va_start(args, number);
+        long a[6];
+
+        for (auto& arg : a)
+            arg = va_arg(args, long);
+
+        va_end(args);
+
+        noteCall(syscallCall);
+        return real(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+    }
+}
+
+void* operator new(size_t size)
+{
+    noteCall(newCall);
+
+    if (auto* block = __libc_malloc(size > 0 ? size : 1))
+        return block;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)                   { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    noteCall(newCall);
+    return __libc_malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept    { return operator new(size, tag); }
+
+void operator delete(void* block) noexcept
+{
+    if (block != nullptr)
+        noteCall(deleteCall);
+
+    __libc_free(block);
+}
+
+void operator delete[](void* block) noexcept            { operator delete(block); }
+void operator delete(void* block, size_t) noexcept      { operator delete(block); }
+void operator delete[](void* block, size_t) noexcept    { operator delete(block); }
+
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int blocksPerScenario = 400;
+
+    // Anything a host might send: note-ons (some with velocity 0), note-offs, controllers,
+    // pitch bends and the odd sysex, on all 16 channels. Half land in the first few samples,
+    // so chords and repeats are common. Built before processBlock, so its allocations don't count.
+    void fillRandomBlock(juce::MidiBuffer& midi, juce::Random& random)
+    {
+        midi.clear();
+
+        for (int i = random.nextInt(49); --i >= 0;)
+        {
+            const auto channel = 1 + random.nextInt(16);
+            const auto note = random.nextInt(128);
+            const auto position = random.nextBool() ? random.nextInt(blockSize) : random.nextInt(4);
+
+            switch (random.nextInt(8))
+            {
+                case 0:
+                case 1:
+                case 2:     midi.addEvent(juce::MidiMessage::noteOn(channel, note, (juce::uint8) random.nextInt(128)), position); break;
+                case 3:
+                case 4:     midi.addEvent(juce::MidiMessage::noteOff(channel, note, (juce::uint8) random.nextInt(128)), position); break;
+                case 5:     midi.addEvent(juce::MidiMessage::controllerEvent(channel, random.nextInt(128), random.nextInt(128)), position); break;
+                case 6:     midi.addEvent(juce::MidiMessage::pitchWheel(channel, random.nextInt(16384)), position); break;
+
+                default:
+                {
+                    const juce::uint8 sysex[] = { 0x7d, (juce::uint8) note, 0x01, 0x02 };
+                    midi.addEvent(juce::MidiMessage::createSysExMessage(sysex, (int) sizeof(sysex)), position);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Host automation arriving with a block: hosts set it on the audio thread, without notifying
+    void automate(const juce::Array<juce::AudioProcessorParameter*>& parameters, juce::Random& random)
+    {
+        for (int i = random.nextInt(4); --i >= 0;)
+            parameters.getUnchecked(random.nextInt(parameters.size()))->setValue(random.nextFloat());
+    }
+
+    template <typename ParameterType, typename ValueType>
+    void set(ParameterType* parameter, ValueType value)
+    {
+        *parameter = value;
+    }
+
+    struct Scenario
+    {
+        const char* name;
+        std::function<void(NewProjectAudioProcessor&)> setUp;
+        bool automateEverything = false;
+    };
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    const juce::StringArray args(argv + 1, argc - 1);
+    trapOnCall = args.contains("--trap");
+
+    const auto seedIndex = args.indexOf("--seed");
+    const auto seed = seedIndex >= 0 ? args[seedIndex + 1].getLargeIntValue() : juce::Random::getSystemRandom().nextInt64();
+    std::cout << "seed " << seed << std::endl;
+
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    NewProjectAudioProcessor processor;
+    ToolHost::Transport transport(sampleRate);
+
+   #if ! JucePlugin_IsMidiEffect
+    auto layout = processor.getBusesLayout();
+    layout.inputBuses.getReference(layout.inputBuses.size() - 1) = juce::AudioChannelSet::stereo();
+    processor.setBusesLayout(layout);
+   #endif
+
+    processor.setPlayHead(&transport);
+    processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+    processor.prepareToPlay(sampleRate, blockSize);
+
+    juce::AudioBuffer<float> buffer(juce::jmax(processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels()), blockSize);
+    juce::MidiBuffer midi;
+
+    // a host hands over a buffer with room for what comes back; growing it would be ours
+    midi.ensureSize(64 * 1024);
+
+    const auto captureFile = juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("realtime-check.mvvcap");
+
+    const Scenario scenarios[] =
+    {
+        { "defaults",               [] (auto&) {} },
+        { "BASE VALUE, centred",    [] (auto& p) { set(p.base, 1); set(p.direction, 1); } },
+        { "INTENSITY 0",            [] (auto& p) { set(p.skew, 0); } },
+        { "INTENSITY 5, down",      [] (auto& p) { set(p.skew, 5); set(p.direction, 2); } },
+        { "ADAPTIVE",               [] (auto& p) { set(p.base, 0); set(p.adaptive, true); } },
+        { "NO REPEAT",              [] (auto& p) { set(p.antiRepeat, true); } },
+        { "CHORDS",                 [] (auto& p) { set(p.chords, true); } },
+        { "FAST REPEATS",           [] (auto& p) { set(p.repetitionAmount, 80); } },
+        { "FIXED SEED",             [] (auto& p) { set(p.deterministic, true); set(p.seed, 1234); } },
+        { "offline tier",           [] (auto& p) { set(p.deterministic, false); p.setNonRealtime(true); } },
+        { "lanes",                  [] (auto& p) { for (int i = 0; i < NewProjectAudioProcessor::numExtraLanes; ++i) set(p.lanes[(size_t) i].channel, i + 2); } },
+        { "doubles",                [] (auto& p) { for (int i = 0; i < NewProjectAudioProcessor::maxDoubles; ++i) set(p.doubles[(size_t) i].channel, 10 + i); } },
+        { "FREEZE",                 [] (auto& p) { set(p.freeze, true); p.runHousekeeping(); } },
+        { "GLOBAL",                 [] (auto& p) { set(p.useGlobalControls, true); p.runHousekeeping(); } },
+       #if ! JucePlugin_IsMidiEffect
+        { "sidechain",              [] (auto& p) { set(p.sidechainAmount, 50); set(p.sidechainDetector, 1); } },
+       #endif
+        { "capture",                [&] (auto& p) { p.startCapture(captureFile); } },
+        { "automating everything",  [] (auto&) {}, true },
+    };
+
+    // everything but the switches the scenarios turn on: the booleans and the lane and double channels
+    juce::Array<juce::AudioProcessorParameter*> steadyParameters, allParameters;
+
+    for (auto* parameter : processor.getParameters())
+    {
+        allParameters.add(parameter);
+
+        if (auto* withID = dynamic_cast<juce::AudioProcessorParameterWithID*> (parameter))
+            if (dynamic_cast<juce::AudioParameterBool*> (parameter) == nullptr && ! withID->paramID.endsWith("Channel"))
+                steadyParameters.add(parameter);
+    }
+
+    int failures = 0;
+    int blockIndex = 0;
+
+    // each scenario keeps the ones before it switched on, so the last runs everything together
+    for (auto& scenario : scenarios)
+    {
+        scenario.setUp(processor);
+        std::fill(std::begin(callCounts), std::end(callCounts), 0);
+
+        const auto& automated = scenario.automateEverything ? allParameters : steadyParameters;
+
+        for (int b = 0; b < blocksPerScenario; ++b, ++blockIndex)
+        {
+            juce::Random random(seed + blockIndex);
+            fillRandomBlock(midi, random);
+
+            for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+                juce::FloatVectorOperations::fill(buffer.getWritePointer(ch), ((blockIndex + ch) % 7 - 3) * 0.1f, blockSize);
+
+            insideProcessBlock = true;
+            automate(automated, random);
+            processor.processBlock(buffer, midi);
+            insideProcessBlock = false;
+
+            transport.advance(blockSize);
+
+            // the message thread's share of FREEZE: draining the journal, and following automation of the switch
+            if (b % 10 == 9)
+                processor.runHousekeeping();
+        }
+
+        juce::String report;
+
+        for (int c = 0; c < numCalls; ++c)
+            if (callCounts[c] > 0)
+                report << " " << callNames[c] << " x" << callCounts[c];
+
+        std::cout << (report.isEmpty() ? "ok    " : "FAIL  ") << scenario.name << report << std::endl;
+
+        if (report.isNotEmpty())
+            ++failures;
+    }
+
+    processor.stopCapture();
+    processor.releaseResources();
+    processor.setPlayHead(nullptr);
+    captureFile.deleteFile();
+
+    std::cout << failures << " of " << juce::numElementsInArray(scenarios) << " scenarios allocated, locked, waited or made a system call";
+
+    if (failures > 0)
+        std::cout << "; repeat with --seed " << seed;
+
+    std::cout << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    Replays a capture recorded with the editor's REC button.
+
+    Every recorded block goes back through NewProjectAudioProcessor's own
+    kernels, and the output is compared with what the plugin sent live. Prints
+    the note-ons of each block with their live and replayed velocities, and
+    exits with 1 if any block came out differently.
+
+    Build it as ToolHost.h describes, from the same revision that made the
+    capture.
+
+    Usage:
+        replay-capture <file.mvvcap> [--quiet]
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../PluginProcessor.h"
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: replay-capture <file.mvvcap> [--quiet]" << std::endl;
+        return 2;
+    }
+
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    const auto file = juce::File::getCurrentWorkingDirectory().getChildFile(argv[1]);
+    const auto quiet = argc > 2 && juce::String(argv[2]) == "--quiet";
+
+    juce::FileInputStream stream(file);
+
+    if (stream.failedToOpen())
+    {
+        std::cerr << "couldn't open " << file.getFullPathName() << std::endl;
+        return 2;
+    }
+
+    NewProjectAudioProcessor processor;
+    int numBlocks = 0;
+
+    const auto mismatches = processor.replayCapture(stream, [&] (const NewProjectAudioProcessor::ReplayedBlock& block)
+    {
+        ++numBlocks;
+
+        if (quiet)
+            return;
+
+        auto live = block.recordedOutput.begin();
+
+        for (const auto metadata : block.output)
+        {
+            const auto replayed = metadata.getMessage();
+            const auto recorded = live != block.recordedOutput.end() ? (*live++).getMessage() : juce::MidiMessage();
+
+            if (replayed.isNoteOn())
+                std::cout << block.startPosition + metadata.samplePosition
+                          << "\tch " << replayed.getChannel()
+                          << "\tnote " << replayed.getNoteNumber()
+                          << "\tlive " << (recorded.isNoteOn() ? (int) recorded.getVelocity() : -1)
+                          << "\treplay " << (int) replayed.getVelocity() << "\n";
+        }
+    });
+
+    if (mismatches < 0)
+    {
+        std::cerr << file.getFileName() << " isn't a capture from this build" << std::endl;
+        return 2;
+    }
+
+    std::cout << numBlocks << " blocks replayed, " << mismatches << " differed from the capture" << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+/*
+  ==============================================================================
+
+    How the plugin scales with the number of instances in one process.
+
+    For 1, 10, 100 and 1000 instances (or up to the count given) it measures:
+      - construction and destruction time
+      - the memory each instance and each open editor costs: what
+        getMemoryFootprint() reports, and, on Linux, how much the resident
+        set grew divided by the number of them
+      - processBlock time across all of them, as a share of one core in real
+        time, with note-ons and note-offs spread over every block
+      - editor churn: one editor opened and closed 50 times, per open and close
+      - idle load: the CPU the message thread uses with every editor open and
+        nothing changing, which is what the shared refresh timer costs
+      - the same with no editors open, which is what housekeeping costs
+
+    Build it as ToolHost.h describes, with JUCE_MODAL_LOOPS_PERMITTED=1 so it
+    can run the message loop. Editors need a display; run it under Xvfb on a
+    headless machine.
+
+    Usage:
+        scaling-bench [max instances, default 1000] [idle seconds, default 2]
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../PluginProcessor.h"
+#include "../PluginEditor.h"
+#include "ToolHost.h"
+
+#include <ctime>
+
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 256;
+    constexpr int blocksPerInstance = 100;
+    constexpr int editorOpens = 50;
+
+    double getSecondsSince(juce::int64 startTicks)
+    {
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+    }
+
+    // process CPU over wall time while the message loop runs on its own, in percent of one core
+    double measureIdleLoad(double seconds)
+    {
+        const auto cpuStart = std::clock();
+        const auto wallStart = juce::Time::getHighResolutionTicks();
+
+        juce::MessageManager::getInstance()->runDispatchLoopUntil((int) (seconds * 1000.0));
+
+        const auto cpuSeconds = (double) (std::clock() - cpuStart) / CLOCKS_PER_SEC;
+        return 100.0 * cpuSeconds / getSecondsSince(wallStart);
+    }
+
+    struct Instance
+    {
+        std::unique_ptr<NewProjectAudioProcessor> processor;
+        std::unique_ptr<juce::AudioProcessorEditor> editor;
+    };
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    const auto maxInstances = argc > 1 ? juce::jmax(1, juce::String(argv[1]).getIntValue()) : 1000;
+    const auto idleSeconds = argc > 2 ? juce::jmax(0.1, juce::String(argv[2]).getDoubleValue()) : 2.0;
+
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::AudioBuffer<float> buffer(2, blockSize);
+    juce::MidiBuffer midi;
+    midi.ensureSize(4096);
+
+    std::cout << "instances  create ms  destroy ms  footprint each  resident each  editor footprint  editor resident"
+                 "  process % core  editor open+close ms  idle % core (editors / none)\n";
+
+    for (int numInstances = 1; numInstances <= maxInstances; numInstances *= 10)
+    {
+        std::vector<Instance> instances((size_t) numInstances);
+
+        const auto residentBefore = ToolHost::getResidentBytes();
+        auto start = juce::Time::getHighResolutionTicks();
+
+        for (auto& instance : instances)
+        {
+            instance.processor = std::make_unique<NewProjectAudioProcessor>();
+            instance.processor->setRateAndBufferSizeDetails(sampleRate, blockSize);
+            instance.processor->prepareToPlay(sampleRate, blockSize);
+        }
+
+        const auto createMs = 1000.0 * getSecondsSince(start);
+        const auto footprintEach = (juce::int64) instances.front().processor->getMemoryFootprint().getTotalBytes();
+
+        // every instance plays the same part, like a template with many tracks
+        start = juce::Time::getHighResolutionTicks();
+
+        for (int b = 0; b < blocksPerInstance; ++b)
+        {
+            for (auto& instance : instances)
+            {
+                ToolHost::fillBlock(midi, b, blockSize);
+                buffer.clear();
+                instance.processor->processBlock(buffer, midi);
+            }
+        }
+
+        const auto processPercent = 100.0 * getSecondsSince(start) / (blocksPerInstance * blockSize / sampleRate);
+
+        // measured after processing, so buffers that only grow on first use are counted
+        const auto residentWithProcessors = ToolHost::getResidentBytes();
+        const auto residentEach = (residentWithProcessors - residentBefore) / numInstances;
+
+        // editor churn: the whole component tree is built and torn down each time
+        start = juce::Time::getHighResolutionTicks();
+
+        for (int i = 0; i < editorOpens; ++i)
+        {
+            instances.front().editor.reset(instances.front().processor->createEditor());
+            instances.front().editor.reset();
+        }
+
+        const auto editorMs = 1000.0 * getSecondsSince(start) / editorOpens;
+
+        for (auto& instance : instances)
+            instance.editor.reset(instance.processor->createEditor());
+
+        const auto editorFootprint = (juce::int64) dynamic_cast<AarrowAudioProcessorEditor&> (*instances.front().editor).getMemoryFootprint().getTotalBytes();
+        const auto editorResident = (ToolHost::getResidentBytes() - residentWithProcessors) / numInstances;
+        const auto idleWithEditors = measureIdleLoad(idleSeconds);
+
+        for (auto& instance : instances)
+            instance.editor.reset();
+
+        const auto idleWithoutEditors = measureIdleLoad(idleSeconds);
+
+        start = juce::Time::getHighResolutionTicks();
+
+        for (auto& instance : instances)
+        {
+            instance.processor->releaseResources();
+            instance.processor.reset();
+        }
+
+        const auto destroyMs = 1000.0 * getSecondsSince(start);
+
+        std::cout << juce::String(numInstances).paddedLeft(' ', 9)
+                  << juce::String(createMs, 1).paddedLeft(' ', 11)
+                  << juce::String(destroyMs, 1).paddedLeft(' ', 12)
+                  << juce::String(footprintEach).paddedLeft(' ', 16)
+                  << juce::String(residentEach).paddedLeft(' ', 15)
+                  << juce::String(editorFootprint).paddedLeft(' ', 18)
+                  << juce::String(editorResident).paddedLeft(' ', 17)
+                  << juce::String(processPercent, 2).paddedLeft(' ', 16)
+                  << juce::String(editorMs, 2).paddedLeft(' ', 22)
+                  << juce::String(idleWithEditors, 2).paddedLeft(' ', 14) << " / " << juce::String(idleWithoutEditors, 2)
+                  << std::endl;
+    }
+
+    return 0;
+}
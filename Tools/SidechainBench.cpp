@@ -0,0 +1,117 @@
+/*
+  ==============================================================================
+
+    Measures what the sidechain costs at a 64 sample block size.
+
+    Runs ten seconds of 48 kHz audio through NewProjectAudioProcessor, with a
+    note-on and note-off in every block, once with SIDECHAIN at 0 and once at
+    50% with a signal on the sidechain bus, then prints each pass as a
+    percentage of one core in real time. Exits with 1 if the sidechain adds
+    more than 1%, the budget it was designed for.
+
+    Build it as ToolHost.h describes, in Release and not as a MIDI effect,
+    which has no sidechain.
+
+    Usage:
+        sidechain-bench [--rms]
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../PluginProcessor.h"
+
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 64;
+    constexpr int numBlocks = (int) (10 * sampleRate) / blockSize;
+    constexpr double budgetPercent = 1.0;
+
+    // percent of one core that processing numBlocks blocks took, against their duration.
+    // Both passes copy the same signal in, so only the processor's own work differs.
+    double runPass(NewProjectAudioProcessor& processor, juce::AudioBuffer<float>& buffer,
+                   int sidechainChannel, const juce::AudioBuffer<float>& signal)
+    {
+        juce::MidiBuffer midi;
+        const auto start = juce::Time::getHighResolutionTicks();
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            const auto offset = (b * blockSize) % signal.getNumSamples();
+
+            for (int ch = sidechainChannel; ch < buffer.getNumChannels(); ++ch)
+                buffer.copyFrom(ch, 0, signal, 0, offset, blockSize);
+
+            const auto note = 36 + b % 48;
+            midi.clear();
+            midi.addEvent(juce::MidiMessage::noteOn(1, note, (juce::uint8) 100), 0);
+            midi.addEvent(juce::MidiMessage::noteOff(1, note), blockSize / 2);
+
+            processor.processBlock(buffer, midi);
+        }
+
+        const auto seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+        return 100.0 * seconds / (numBlocks * blockSize / sampleRate);
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+#if JucePlugin_IsMidiEffect
+    juce::ignoreUnused(argc, argv);
+    std::cerr << "this build is a MIDI effect, which has no sidechain" << std::endl;
+    return 2;
+#else
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    NewProjectAudioProcessor processor;
+
+    auto layout = processor.getBusesLayout();
+    layout.inputBuses.getReference(layout.inputBuses.size() - 1) = juce::AudioChannelSet::stereo();
+
+    if (! processor.setBusesLayout(layout))
+    {
+        std::cerr << "couldn't enable the sidechain bus" << std::endl;
+        return 2;
+    }
+
+    processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+    processor.prepareToPlay(sampleRate, blockSize);
+
+    const auto sidechainChannel = processor.getChannelIndexInProcessBlockBuffer(true, layout.inputBuses.size() - 1, 0);
+    juce::AudioBuffer<float> buffer(juce::jmax(processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels()), blockSize);
+    buffer.clear();
+
+    // one second of noise under a 2 Hz amplitude wobble, so the envelope never settles
+    juce::AudioBuffer<float> signal(1, (int) sampleRate);
+    juce::Random random(1);
+
+    for (int i = 0; i < signal.getNumSamples(); ++i)
+        signal.setSample(0, i, (float) (0.5 + 0.5 * std::sin(juce::MathConstants<double>::twoPi * 2.0 * i / sampleRate))
+                                   * (random.nextFloat() * 2.0f - 1.0f));
+
+    *processor.sidechainDetector = argc > 1 && juce::String(argv[1]) == "--rms" ? 1 : 0;
+
+    // the first pass warms the caches for both
+    *processor.sidechainAmount = 0;
+    runPass(processor, buffer, sidechainChannel, signal);
+    const auto withoutSidechain = runPass(processor, buffer, sidechainChannel, signal);
+
+    *processor.sidechainAmount = 50;
+    const auto withSidechain = runPass(processor, buffer, sidechainChannel, signal);
+
+    processor.releaseResources();
+
+    const auto added = withSidechain - withoutSidechain;
+
+    std::cout << "64 samples at 48 kHz, " << numBlocks << " blocks\n"
+              << "  SIDECHAIN off: " << juce::String(withoutSidechain, 3) << "% of one core\n"
+              << "  SIDECHAIN 50%: " << juce::String(withSidechain, 3) << "% of one core\n"
+              << "  sidechain adds " << juce::String(added, 3) << "%, budget " << juce::String(budgetPercent, 1) << "%" << std::endl;
+
+    return added <= budgetPercent ? 0 : 1;
+#endif
+}
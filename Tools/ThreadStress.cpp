@@ -0,0 +1,260 @@
+/*
+  ==============================================================================
+
+    Many instances on many threads at once, for ThreadSanitizer.
+
+    Creates N instances from M threads at the same moment, as hosts that load
+    a session in parallel do, and checks that their live random streams all
+    differ. Then it measures throughput with the instances spread over 1, 2,
+    4 ... M audio threads, and the scaling efficiency: the speed-up over one
+    thread, divided by the number of threads. Something that serialises the
+    instances, such as a lock they all share, shows up as efficiency falling
+    towards 1 / threads. Only thread counts up to the number of physical
+    cores are held to the minimum, since hyper-threads share a core. Last
+    comes the stress: M audio threads run their share of the instances flat
+    out while this thread plays the host's message thread, automating
+    parameters, saving and restoring state, switching FREEZE and GLOBAL,
+    running housekeeping, re-rolling and starting and stopping captures.
+    Everything is then destroyed from M threads at once.
+
+    Beyond the seeds and the scaling the run checks little; the point is to
+    give ThreadSanitizer every shared structure under real contention. Build
+    it as ToolHost.h describes, adding
+
+        -fsanitize=thread -g -O1
+
+    to every file, JUCE's included. Timings under the sanitizer mean little,
+    so give a minimum efficiency of 0 there. Exits with 1 if two instances
+    came out with the same stream or the efficiency fell below the minimum;
+    ThreadSanitizer exits with 66 on a race.
+
+    Usage:
+        thread-stress [instances, default 64] [threads, default the number of CPUs]
+                      [seconds, default 5] [minimum efficiency, default 0.5]
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../PluginProcessor.h"
+#include "ToolHost.h"
+
+#include <atomic>
+#include <functional>
+#include <set>
+#include <thread>
+#include <vector>
+
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 128;
+
+    // Runs body(i) for every i below count, spread over numThreads threads started together
+    template <typename Body>
+    void runOnThreads(int numThreads, int count, Body&& body)
+    {
+        std::atomic<int> next { 0 };
+        std::vector<std::thread> threads;
+
+        for (int t = 0; t < numThreads; ++t)
+            threads.emplace_back([&]
+            {
+                for (int i; (i = next.fetch_add(1)) < count;)
+                    body(i);
+            });
+
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    struct Instance
+    {
+        std::unique_ptr<NewProjectAudioProcessor> processor;
+        ToolHost::Transport transport { sampleRate };      // advanced only by the thread running this instance
+    };
+
+    // Runs every instance on numThreads audio threads, each keeping its own instances as a host
+    // would, and calls messageThreadStep() on this thread until seconds have passed. Returns
+    // the number of blocks processed.
+    juce::int64 runAudioThreads(std::vector<Instance>& instances, int numThreads, double seconds,
+                                const std::function<void()>& messageThreadStep)
+    {
+        std::atomic<bool> stop { false };
+        std::atomic<juce::int64> blocksProcessed { 0 };
+        std::vector<std::thread> audioThreads;
+        const auto numInstances = (int) instances.size();
+
+        for (int t = 0; t < numThreads; ++t)
+        {
+            audioThreads.emplace_back([&, t]
+            {
+                juce::AudioBuffer<float> buffer(2, blockSize);
+                juce::MidiBuffer midi;
+                midi.ensureSize(16 * 1024);
+                juce::int64 blocks = 0;
+
+                for (int blockIndex = 1; ! stop.load(); ++blockIndex)
+                {
+                    for (int i = t; i < numInstances; i += numThreads, ++blocks)
+                    {
+                        auto& instance = instances[(size_t) i];
+                        ToolHost::fillBlock(midi, blockIndex, blockSize);
+                        buffer.clear();
+                        instance.processor->processBlock(buffer, midi);
+                        instance.transport.advance(blockSize);
+                    }
+                }
+
+                blocksProcessed += blocks;
+            });
+        }
+
+        const auto end = juce::Time::getMillisecondCounterHiRes() + seconds * 1000.0;
+
+        while (juce::Time::getMillisecondCounterHiRes() < end)
+            messageThreadStep();
+
+        stop = true;
+
+        for (auto& thread : audioThreads)
+            thread.join();
+
+        return blocksProcessed.load();
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    const auto numInstances = argc > 1 ? juce::jmax(2, juce::String(argv[1]).getIntValue()) : 64;
+    const auto numThreads = argc > 2 ? juce::jmax(1, juce::String(argv[2]).getIntValue()) : juce::SystemStats::getNumCpus();
+    const auto seconds = argc > 3 ? juce::jmax(0.1, juce::String(argv[3]).getDoubleValue()) : 5.0;
+    const auto minimumEfficiency = argc > 4 ? juce::String(argv[4]).getDoubleValue() : 0.5;
+
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    std::vector<Instance> instances((size_t) numInstances);
+
+    runOnThreads(numThreads, numInstances, [&] (int i) { instances[(size_t) i].processor = std::make_unique<NewProjectAudioProcessor>(); });
+
+    for (auto& instance : instances)
+    {
+        instance.processor->setPlayHead(&instance.transport);
+        instance.processor->setRateAndBufferSizeDetails(sampleRate, blockSize);
+        instance.processor->prepareToPlay(sampleRate, blockSize);
+    }
+
+    // the same four blocks through every fresh instance: the velocities only differ if the seeds do
+    std::set<juce::String> streams;
+
+    for (auto& instance : instances)
+    {
+        juce::AudioBuffer<float> buffer(2, blockSize);
+        juce::MidiBuffer midi;
+        juce::String velocities;
+
+        for (int b = 0; b < 4; ++b)
+        {
+            ToolHost::fillBlock(midi, b, blockSize);
+            instance.processor->processBlock(buffer, midi);
+            instance.transport.advance(blockSize);
+
+            for (const auto metadata : midi)
+                if (metadata.getMessage().isNoteOn())
+                    velocities << (int) metadata.getMessage().getVelocity() << " ";
+        }
+
+        streams.insert(velocities);
+    }
+
+    // 16 note-ons at RANGE 10: two fresh seeds giving the same velocities is next to impossible
+    const auto numDistinct = (int) streams.size();
+    std::cout << numInstances << " instances created on " << numThreads << " threads, "
+              << numDistinct << " distinct velocity streams" << std::endl;
+
+    //==============================================================================
+    std::cout << "threads  blocks/s  speed-up  efficiency" << std::endl;
+    double singleThreadRate = 0.0;
+    auto scalingFailed = false;
+
+    for (int threads = 1;; threads = juce::jmin(threads * 2, numThreads))
+    {
+        const auto measureSeconds = juce::jmin(seconds, 2.0);
+        const auto blocksPerSecond = (double) runAudioThreads(instances, threads, measureSeconds, [] { juce::Thread::sleep(10); }) / measureSeconds;
+
+        if (threads == 1)
+            singleThreadRate = blocksPerSecond;
+
+        const auto speedUp = blocksPerSecond / singleThreadRate;
+        const auto efficiency = speedUp / threads;
+        const auto tooSlow = efficiency < minimumEfficiency && threads <= juce::SystemStats::getNumPhysicalCpus();
+        scalingFailed = scalingFailed || tooSlow;
+
+        std::cout << juce::String(threads).paddedLeft(' ', 7)
+                  << juce::String(blocksPerSecond, 0).paddedLeft(' ', 10)
+                  << juce::String(speedUp, 2).paddedLeft(' ', 10)
+                  << juce::String(efficiency, 2).paddedLeft(' ', 12)
+                  << (tooSlow ? "  FAIL" : "")
+                  << std::endl;
+
+        if (threads == numThreads)
+            break;
+    }
+
+    // what one instance needs of a core to keep up with real time, from the single thread pass
+    std::cout << juce::String(100.0 * (sampleRate / blockSize) / singleThreadRate, 3) << "% of one core per instance" << std::endl;
+
+    //==============================================================================
+    // the message thread's side, as fast as it will go
+    juce::Random random(1);
+    juce::MemoryBlock state;
+    int actions = 0;
+
+    // one capture file per instance, so no two writers share one
+    auto getCaptureFile = [] (int index)
+    {
+        return juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("thread-stress-" + juce::String(index) + ".mvvcap");
+    };
+
+    const auto blocks = runAudioThreads(instances, numThreads, seconds, [&]
+    {
+        const auto index = random.nextInt(numInstances);
+        auto& processor = *instances[(size_t) index].processor;
+        const auto& parameters = processor.getParameters();
+
+        switch (random.nextInt(8))
+        {
+            case 0:
+            case 1:     parameters[random.nextInt(parameters.size())]->setValueNotifyingHost(random.nextFloat()); break;
+            case 2:     processor.getStateInformation(state); break;
+            case 3:     if (state.getSize() > 0) processor.setStateInformation(state.getData(), (int) state.getSize()); break;
+            case 4:     processor.freeze->setValueNotifyingHost(random.nextBool() ? 1.0f : 0.0f); break;
+            case 5:     processor.useGlobalControls->setValueNotifyingHost(1.0f); break;
+            case 6:     processor.rerollFreeze(); break;
+            case 7:     if (processor.isCapturing()) processor.stopCapture(); else processor.startCapture(getCaptureFile(index)); break;
+            default:    break;
+        }
+
+        processor.runHousekeeping();
+        ++actions;
+    });
+
+    std::cout << blocks << " blocks processed on " << numThreads << " threads against "
+              << actions << " message thread actions" << std::endl;
+
+    for (auto& instance : instances)
+    {
+        instance.processor->stopCapture();
+        instance.processor->releaseResources();
+        instance.processor->setPlayHead(nullptr);
+    }
+
+    runOnThreads(numThreads, numInstances, [&] (int i) { instances[(size_t) i].processor.reset(); });
+
+    for (int i = 0; i < numInstances; ++i)
+        getCaptureFile(i).deleteFile();
+
+    return numDistinct == numInstances && ! scalingFailed ? 0 : 1;
+}
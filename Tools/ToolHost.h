@@ -0,0 +1,99 @@
+/*
+  ==============================================================================
+
+    What the JUCE command line tools share: a host's transport, the MIDI they
+    play, and a look at the process's memory.
+
+    Building them: each JUCE tool is a JUCE console application made from the
+    same JuceHeader and JucePlugin_ settings as the plugin, with
+    PluginProcessor.cpp, PluginEditor.cpp and GlobalControls.cpp added next to
+    the tool's own .cpp. Anything a tool needs on top of that, such as extra
+    flags or a display, is in its own header comment. The tools that don't
+    include this file build without JUCE, as their headers say.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <cstdio>
+
+#if JUCE_LINUX
+ #include <unistd.h>
+#endif
+
+namespace ToolHost
+{
+    //==============================================================================
+    // A playing transport at 120 bpm, so FREEZE has a timeline. Given a loop length in
+    // samples, positions wrap round it as a looping host's do. Only the thread that
+    // processes its instance should read or advance it.
+    struct Transport : public juce::AudioPlayHead
+    {
+        explicit Transport(double rate = 48000.0, juce::int64 loopSamples = 0)
+            : sampleRate(rate), loopLength(loopSamples)
+        {
+        }
+
+        juce::Optional<PositionInfo> getPosition() const override
+        {
+            const auto position = loopLength > 0 ? samplePosition % loopLength : samplePosition;
+
+            PositionInfo info;
+            info.setIsPlaying(true);
+            info.setIsLooping(loopLength > 0);
+            info.setBpm(120.0);
+            info.setTimeInSamples(position);
+            info.setPpqPosition(position / sampleRate * 2.0);
+            return info;
+        }
+
+        void advance(int numSamples) noexcept   { samplePosition += numSamples; }
+
+        double sampleRate;
+        juce::int64 loopLength;
+        juce::int64 samplePosition = 0;
+    };
+
+    //==============================================================================
+    // Plain playing, the same every time for the same block: one note on each of
+    // channels 1..numChannels, their note-ons spread over the first half of the block
+    // and their note-offs over the second
+    inline void fillBlock(juce::MidiBuffer& midi, juce::int64 blockIndex, int blockSize, int numChannels = 4)
+    {
+        midi.clear();
+
+        for (int channel = 1; channel <= numChannels; ++channel)
+        {
+            const auto offset = (channel - 1) * blockSize / (2 * numChannels);
+            const auto note = 36 + (int) ((blockIndex * 5 + channel * 7) % 48);
+            const auto velocity = 40 + (int) ((blockIndex + channel * 20) % 80);
+
+            midi.addEvent(juce::MidiMessage::noteOn(channel, note, (juce::uint8) velocity), offset);
+            midi.addEvent(juce::MidiMessage::noteOff(channel, note), blockSize / 2 + offset);
+        }
+    }
+
+    //==============================================================================
+    // Resident set size in bytes, or 0 where there's no cheap way to read it
+    inline juce::int64 getResidentBytes()
+    {
+       #if JUCE_LINUX
+        long long totalPages = 0, residentPages = 0;
+
+        if (auto* statm = std::fopen("/proc/self/statm", "r"))
+        {
+            if (std::fscanf(statm, "%lld %lld", &totalPages, &residentPages) != 2)
+                residentPages = 0;
+
+            std::fclose(statm);
+        }
+
+        return (juce::int64) residentPages * (juce::int64) sysconf(_SC_PAGESIZE);
+       #else
+        return 0;
+       #endif
+    }
+}
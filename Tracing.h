@@ -0,0 +1,235 @@
+/*
+  ==============================================================================
+
+    Optional Chrome trace (chrome://tracing, ui.perfetto.dev) instrumentation.
+
+    Compiled out unless MIDI_VELOCITY_TRACING is defined to 1, in which case
+    TRACE_SCOPE("name") records a span from that line to the end of the scope.
+    Each thread writes into its own preallocated single-producer ring, so a
+    span costs two tick reads and a few stores, and a full ring drops spans
+    rather than blocking. A background thread drains the rings four times a
+    second into MIDIVelocityVariation-<time>.json in the temp directory.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#ifndef MIDI_VELOCITY_TRACING
+ #define MIDI_VELOCITY_TRACING 0
+#endif
+
+#if MIDI_VELOCITY_TRACING
+
+//==============================================================================
+class TraceRecorder : private juce::Thread
+{
+public:
+    TraceRecorder()
+        : juce::Thread("Trace writer"),
+          generation(++lastGeneration),
+          startTicks(juce::Time::getHighResolutionTicks())
+    {
+        for (auto& buffer : buffers)
+            buffer.events.allocate(eventsPerThread, false);
+
+        const auto name = "MIDIVelocityVariation-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S") + ".json";
+        stream = juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile(name).createOutputStream();
+
+        if (stream != nullptr)
+            *stream << "[\n";
+
+        current = this;
+        startThread();
+    }
+
+    ~TraceRecorder() override
+    {
+        current = nullptr;
+        stopThread(2000);
+        flush();
+
+        if (stream != nullptr)
+        {
+            *stream << "\n]\n";
+            stream->flush();
+        }
+    }
+
+    static TraceRecorder* getCurrent() noexcept     { return current.load(std::memory_order_acquire); }
+
+    // Any thread. Never blocks or allocates, drops the span if this thread's ring is full
+    void record(const char* name, juce::int64 start, juce::int64 end) noexcept
+    {
+        auto* buffer = getThreadBuffer();
+
+        if (buffer == nullptr)
+            return;
+
+        const auto head = buffer->head.load(std::memory_order_relaxed);
+
+        if (head - buffer->tail.load(std::memory_order_acquire) >= eventsPerThread)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        buffer->events[head % eventsPerThread] = { name, start, end };
+        buffer->head.store(head + 1, std::memory_order_release);
+    }
+
+private:
+    static constexpr size_t maxThreads = 32;
+    static constexpr size_t eventsPerThread = 8192;
+
+    struct Span
+    {
+        const char* name;
+        juce::int64 start, end;
+    };
+
+    struct ThreadBuffer
+    {
+        juce::HeapBlock<Span> events;
+        std::atomic<size_t> head { 0 }, tail { 0 };
+        bool isMessageThread = false;
+        bool named = false;     // writer thread only
+    };
+
+    ThreadBuffer* getThreadBuffer() noexcept
+    {
+        // the pointer is only trusted while it was handed out by this same recorder
+        thread_local ThreadBuffer* buffer = nullptr;
+        thread_local juce::uint32 bufferGeneration = 0;
+
+        if (bufferGeneration != generation)
+        {
+            const auto slot = numClaimed.fetch_add(1, std::memory_order_relaxed);
+            buffer = slot < maxThreads ? &buffers[slot] : nullptr;
+            bufferGeneration = generation;
+
+            if (buffer != nullptr)
+            {
+                buffer->isMessageThread = juce::MessageManager::existsAndIsCurrentThread();
+                claimed[slot].store(true, std::memory_order_release);
+            }
+        }
+
+        return buffer;
+    }
+
+    //==============================================================================
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            wait(250);
+            flush();
+        }
+    }
+
+    void flush()
+    {
+        if (stream == nullptr)
+            return;
+
+        for (size_t slot = 0; slot < maxThreads; ++slot)
+        {
+            if (! claimed[slot].load(std::memory_order_acquire))
+                continue;
+
+            auto& buffer = buffers[slot];
+            const auto tid = juce::String((int) slot + 1);
+
+            if (! buffer.named)
+            {
+                const auto threadName = buffer.isMessageThread ? juce::String("message thread") : "thread " + tid;
+                writeEvent("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid
+                             + ",\"args\":{\"name\":\"" + threadName + "\"}}");
+                buffer.named = true;
+            }
+
+            const auto head = buffer.head.load(std::memory_order_acquire);
+            auto tail = buffer.tail.load(std::memory_order_relaxed);
+
+            for (; tail != head; ++tail)
+            {
+                const auto& span = buffer.events[tail % eventsPerThread];
+                writeEvent("{\"name\":\"" + juce::String(span.name) + "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + tid
+                             + ",\"ts\":" + juce::String(toMicroseconds(span.start), 3)
+                             + ",\"dur\":" + juce::String(toMicroseconds(span.end) - toMicroseconds(span.start), 3) + "}");
+            }
+
+            buffer.tail.store(tail, std::memory_order_release);
+        }
+
+        if (const auto numDropped = dropped.exchange(0, std::memory_order_relaxed))
+            writeEvent("{\"name\":\"dropped spans\",\"ph\":\"C\",\"pid\":1,\"ts\":"
+                         + juce::String(toMicroseconds(juce::Time::getHighResolutionTicks()), 3)
+                         + ",\"args\":{\"count\":" + juce::String((juce::int64) numDropped) + "}}");
+
+        stream->flush();
+    }
+
+    void writeEvent(const juce::String& json)
+    {
+        if (! firstEvent)
+            *stream << ",\n";
+
+        *stream << json;
+        firstEvent = false;
+    }
+
+    double toMicroseconds(juce::int64 ticks) const noexcept
+    {
+        return juce::Time::highResolutionTicksToSeconds(ticks - startTicks) * 1.0e6;
+    }
+
+    //==============================================================================
+    static inline std::atomic<TraceRecorder*> current { nullptr };
+    static inline std::atomic<juce::uint32> lastGeneration { 0 };
+
+    const juce::uint32 generation;
+    const juce::int64 startTicks;
+
+    std::array<ThreadBuffer, maxThreads> buffers;
+    std::array<std::atomic<bool>, maxThreads> claimed {};
+    std::atomic<size_t> numClaimed { 0 };
+    std::atomic<size_t> dropped { 0 };
+
+    std::unique_ptr<juce::FileOutputStream> stream;
+    bool firstEvent = true;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TraceRecorder)
+};
+
+//==============================================================================
+class ScopedTraceSpan
+{
+public:
+    explicit ScopedTraceSpan(const char* spanName) noexcept
+        : name(spanName), start(juce::Time::getHighResolutionTicks())
+    {
+    }
+
+    ~ScopedTraceSpan()
+    {
+        if (auto* recorder = TraceRecorder::getCurrent())
+            recorder->record(name, start, juce::Time::getHighResolutionTicks());
+    }
+
+private:
+    const char* name;
+    const juce::int64 start;
+};
+
+// name must be a string literal, only the pointer is stored
+#define TRACE_SCOPE(name) const ScopedTraceSpan JUCE_JOIN_MACRO(traceSpan, __LINE__) (name)
+
+#else
+
+#define TRACE_SCOPE(name)
+
+#endif
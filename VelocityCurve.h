@@ -0,0 +1,105 @@
+/*
+  ==============================================================================
+
+    The editable velocity transfer curve applied to incoming velocities.
+
+    The curve is a handful of evenly spaced control points joined by straight
+    lines. It only lives on the message thread; the audio thread sees it as the
+    128 entry table built by createTable(), so a note costs one table read
+    however the curve was drawn.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+class VelocityCurve
+{
+public:
+    enum class Shape { linear, compress, expand, sCurve };
+
+    static constexpr int numPoints = 9;
+
+    using Table = std::array<juce::uint8, 128>;
+
+    VelocityCurve()
+    {
+        setShape(Shape::linear);
+    }
+
+    static juce::StringArray getShapeNames()
+    {
+        return { "Linear", "Compress", "Expand", "S-Curve" };
+    }
+
+    void setShape(Shape shape)
+    {
+        for (int i = 0; i < numPoints; ++i)
+        {
+            const auto x = (float) i / (float) (numPoints - 1);
+
+            switch (shape)
+            {
+                case Shape::compress:   points[(size_t) i] = 0.5f + (x - 0.5f) * 0.5f; break;
+                case Shape::expand:     points[(size_t) i] = juce::jlimit(0.0f, 1.0f, 0.5f + (x - 0.5f) * 1.5f); break;
+                case Shape::sCurve:     points[(size_t) i] = x * x * (3.0f - 2.0f * x); break;
+                case Shape::linear:
+                default:                points[(size_t) i] = x; break;
+            }
+        }
+    }
+
+    //==============================================================================
+    float getPoint(int index) const noexcept               { return points[(size_t) index]; }
+    void setPoint(int index, float value) noexcept         { points[(size_t) index] = juce::jlimit(0.0f, 1.0f, value); }
+
+    // x and the result are both normalised to 0..1
+    float getValue(float x) const noexcept
+    {
+        const auto position = juce::jlimit(0.0f, 1.0f, x) * (float) (numPoints - 1);
+        const auto index = juce::jmin(numPoints - 2, (int) position);
+        const auto fraction = position - (float) index;
+
+        return points[(size_t) index] + (points[(size_t) index + 1] - points[(size_t) index]) * fraction;
+    }
+
+    // Input velocity to curved velocity, never 0 so a note-on can't turn into a note-off
+    Table createTable() const noexcept
+    {
+        Table table;
+
+        for (int v = 0; v < 128; ++v)
+            table[(size_t) v] = (juce::uint8) juce::jlimit(1, 127, juce::roundToInt(getValue((float) v / 127.0f) * 127.0f));
+
+        return table;
+    }
+
+    //==============================================================================
+    juce::String toString() const
+    {
+        juce::StringArray values;
+
+        for (auto p : points)
+            values.add(juce::String(p, 4));
+
+        return values.joinIntoString(" ");
+    }
+
+    static VelocityCurve fromString(const juce::String& text)
+    {
+        VelocityCurve curve;
+        auto values = juce::StringArray::fromTokens(text, false);
+
+        if (values.size() == numPoints)
+            for (int i = 0; i < numPoints; ++i)
+                curve.setPoint(i, values[i].getFloatValue());
+
+        return curve;
+    }
+
+private:
+    std::array<float, numPoints> points;
+};
@@ -0,0 +1,338 @@
+/*
+  ==============================================================================
+
+    The per-note humanizer on top of VelocityKernels.h: fast-repeat handling,
+    NO REPEAT and CHORDS, with the note history they need.
+
+    Header only and free of JUCE, so the plugin, the tools and the C API in
+    VelocityEngineC.h all run exactly the same code and it can be inlined into
+    whatever drives it. Everything here is allocation free; the history is a
+    fixed size block that can be reset, copied or captured as raw bytes.
+
+    A note-on goes through getNoteOnBase() once, then varyNoteOn() for every
+    variation of it that is wanted, then clampVelocity(). Whatever loop drives
+    them is compiled once per mode and picked from a KernelTable, so the
+    per-note path has no mode branches.
+
+    The offline quality tier draws several candidates per note and takes the
+    one whose rank among them comes next in a shuffled order of all the
+    ranks. Every rank is used once per cycle, so a phrase never bunches up
+    at one end of the range, and since each order statistic is taken equally
+    often the velocities follow exactly the same distribution as the one
+    draw the real-time tier makes.
+
+    In the adaptive base mode each channel keeps a running mean, variance and
+    recent range of its velocities, and RANGE becomes the spread the part
+    should end up with rather than an amount to add: flat, quantized input
+    gets all of it, a performance that already has that much spread gets only
+    a quarter.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "VelocityKernels.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+//==============================================================================
+// The last few velocities sent for each note, so that fast repeats can be steered
+// away from the same sampler layer. Fixed size so a lookup never leaves the cache line.
+struct RecentVelocities
+{
+    static constexpr int size = 4;
+    static constexpr int maxRetries = 3;
+
+    void clear() noexcept
+    {
+        std::memset(velocities, 0, sizeof(velocities));
+        std::memset(next, 0, sizeof(next));
+    }
+
+    std::uint8_t velocities[128][size] = {};
+    std::uint8_t next[128] = {};
+};
+
+// The note-on group currently being built in chord mode. Groups are formed while
+// walking the events in time order, so they need no sorting and can span blocks.
+struct ChordGroup
+{
+    bool active = false;
+    std::int64_t start = 0;
+    int offset = 0;
+};
+
+// The offline tier's shuffled order of candidate ranks, one cycle of notes at a time
+struct StratifiedDraws
+{
+    static constexpr int numCandidates = 8;
+
+    std::uint8_t order[numCandidates] = {};
+    std::uint8_t next = numCandidates;      // numCandidates when a new order is due
+};
+
+// Running mean, variance and recent range of one channel's velocities, O(1) per note.
+// The mean and variance are exact (Welford) for the first windowSize notes, then an
+// exponential window of about that many, so they follow a part whose dynamics change.
+// The recent extremes take in every new velocity at once and drift back towards the
+// mean at the same rate, so an old accent stops counting after a window or so.
+struct VelocityStatistics
+{
+    static constexpr int windowSize = 32;
+
+    void add(int velocity) noexcept
+    {
+        if (count < windowSize)
+            ++count;
+
+        const auto value = (float) velocity;
+        const auto weight = 1.0f / (float) count;
+        const auto delta = value - mean;
+
+        mean += weight * delta;
+        variance = (1.0f - weight) * (variance + weight * delta * delta);
+
+        low = std::min(low + weight * (mean - low), value);
+        high = std::max(high + weight * (mean - high), value);
+    }
+
+    float getRecentRange() const noexcept   { return high - low; }
+
+    float mean = 0.0f;
+    float variance = 0.0f;
+    float low = 127.0f, high = 0.0f;     // the recent extremes, empty until the first note
+    int count = 0;
+};
+
+// Everything one stream of notes remembers between notes
+struct NoteHistory
+{
+    void reset() noexcept
+    {
+        recentVelocities.clear();
+        chordGroup = {};
+        stratifiedDraws = {};
+        lastNoteOnPositions.fill(-1);
+        channelStatistics.fill({});
+    }
+
+    RecentVelocities recentVelocities;
+    ChordGroup chordGroup;
+    StratifiedDraws stratifiedDraws;
+
+    // per MIDI channel, for the adaptive base mode
+    std::array<VelocityStatistics, 16> channelStatistics;
+
+    // timeline position of the last note-on for each note, for the repetition rate
+    std::array<std::int64_t, 128> lastNoteOnPositions;
+};
+
+// The options that need the note history, on top of VelocitySettings
+struct NoteOptions
+{
+    bool antiRepeat = false;
+
+    bool chords = false;
+    std::int64_t chordWindow = 0;       // in the same units as positions
+    int chordSpread = 0;
+
+    int repetitionAmount = 0;           // percent
+    std::int64_t fastInterval = 0;      // in the same units as positions
+
+    bool offlineQuality = false;        // best-of-N stratified draws, for offline renders
+};
+
+//==============================================================================
+template <VariationDirection direction, SkewClass skewClass, typename RandomType>
+int getNonRepeatingVelocity(RecentVelocities& recentVelocities, int noteNumber, int velocity,
+                            const VelocitySettings& settings, RandomType& random) noexcept
+{
+    // redraw while the result lands within minDistance of one of this note's last few
+    // velocities, then keep whichever draw was furthest from all of them
+    auto* recent = recentVelocities.velocities[noteNumber];
+    auto& next = recentVelocities.next[noteNumber];
+    const auto minDistance = settings.range / 8 > 1 ? settings.range / 8 : 1;
+
+    std::uint8_t best = 0;
+    int bestDistance = -1;
+
+    for (int attempt = 0; attempt <= RecentVelocities::maxRetries; ++attempt)
+    {
+        const auto candidate = (std::uint8_t) clampVelocity(getVariedVelocity<direction, skewClass>(velocity, settings, random));
+        int distance = 128;
+
+        for (int i = 0; i < RecentVelocities::size; ++i)
+            if (recent[i] != 0 && std::abs((int) candidate - (int) recent[i]) < distance)
+                distance = std::abs((int) candidate - (int) recent[i]);
+
+        if (distance > bestDistance)
+        {
+            best = candidate;
+            bestDistance = distance;
+        }
+
+        if (distance >= minDistance)
+            break;
+    }
+
+    recent[next] = best;
+    next = (std::uint8_t) ((next + 1) % RecentVelocities::size);
+
+    return best;
+}
+
+template <VariationDirection direction, SkewClass skewClass, typename RandomType>
+int getChordVelocity(ChordGroup& chordGroup, int velocity, std::int64_t position, const NoteOptions& options,
+                     const VelocitySettings& settings, RandomType& random) noexcept
+{
+    // every note-on within the window of a group's first note shares that note's offset,
+    // plus a little spread per voice, so chords move together instead of smearing.
+    // A position before the group's start means the timeline jumped back (a loop, a
+    // restart), which always starts a new group.
+    if (! chordGroup.active || position < chordGroup.start || position - chordGroup.start > options.chordWindow)
+    {
+        chordGroup.active = true;
+        chordGroup.start = position;
+        chordGroup.offset = getRandomOffset<skewClass>(settings, random);
+    }
+
+    const auto spread = options.chordSpread > 0 ? random.nextInt(2 * options.chordSpread + 1) - options.chordSpread : 0;
+
+    return applyOffset<direction>(velocity, chordGroup.offset, settings) + spread;
+}
+
+template <VariationDirection direction, SkewClass skewClass, typename RandomType>
+int getStratifiedVelocity(StratifiedDraws& draws, int velocity, const VelocitySettings& settings, RandomType& random) noexcept
+{
+    constexpr int numCandidates = StratifiedDraws::numCandidates;
+
+    if (draws.next >= numCandidates)
+    {
+        for (int i = 0; i < numCandidates; ++i)
+            draws.order[i] = (std::uint8_t) i;
+
+        for (int i = numCandidates - 1; i > 0; --i)
+            std::swap(draws.order[i], draws.order[random.nextInt(i + 1)]);
+
+        draws.next = 0;
+    }
+
+    int offsets[numCandidates];
+
+    for (auto& offset : offsets)
+        offset = getRandomOffset<skewClass>(settings, random);
+
+    const auto rank = draws.order[draws.next++];
+    std::nth_element(offsets, offsets + rank, offsets + numCandidates);
+
+    return applyOffset<direction>(velocity, offsets[rank], settings);
+}
+
+//==============================================================================
+// RANGE for the adaptive mode: a uniform offset over 0..r-1 has a variance of about
+// r * r / 12, so only add what the input's own spread is short of that. The spread is
+// the larger of what the variance and the recent range say, so a steady part with the
+// odd accent counts as dynamic too.
+inline int getAdaptiveRange(const VelocityStatistics& statistics, int range) noexcept
+{
+    const auto recentRange = statistics.getRecentRange();
+    const auto spread = std::max(12.0f * statistics.variance, recentRange * recentRange);
+    const auto missing = (float) (range * range) - spread;
+    const auto adapted = missing > 0.0f ? (int) (std::sqrt(missing) + 0.5f) : 0;
+
+    return adapted > range / 4 ? adapted : range / 4;
+}
+
+// Moves a velocity just far enough from 1 or 127 that every offset in range can
+// still be heard, so flat full-scale input doesn't all clamp back to 127
+template <VariationDirection direction>
+inline int fitToHeadroom(int velocity, int range) noexcept
+{
+    const auto low = direction == VariationDirection::down ? 1 + range
+                   : direction == VariationDirection::centred ? 1 + range / 2 : 1;
+    const auto high = direction == VariationDirection::up ? 127 - range
+                    : direction == VariationDirection::centred ? 127 - (range - range / 2) : 127;
+
+    return velocity < low ? low : (velocity > high ? high : velocity);
+}
+
+// The velocity a note-on starts from, before any random draws. Fast repeats and the
+// adaptive mode change settings.range, so pass a copy of the block's settings.
+template <BaseMode baseMode, VariationDirection direction>
+int getNoteOnBase(NoteHistory& history, const NoteOptions& options, int noteNumber, int channel, int inputVelocity,
+                  std::int64_t position, VelocitySettings& settings) noexcept
+{
+    auto velocity = getBaseVelocity<baseMode>(inputVelocity, settings);
+
+    if constexpr (baseMode == BaseMode::adaptive)
+    {
+        auto& statistics = history.channelStatistics[(size_t) (channel & 15)];
+        statistics.add(velocity);
+
+        settings.range = getAdaptiveRange(statistics, settings.range);
+        velocity = fitToHeadroom<direction>(velocity, settings.range);
+    }
+
+    // one table read and write per note, no history to scan
+    auto& lastPosition = history.lastNoteOnPositions[(size_t) noteNumber];
+
+    if (options.repetitionAmount > 0 && lastPosition >= 0)
+        applyRepetitionSpeed(velocity, settings,
+                             getRepetitionSpeed(position - lastPosition, options.fastInterval),
+                             options.repetitionAmount);
+
+    lastPosition = position;
+    return velocity;
+}
+
+// One variation of a note-on, not yet clamped. CHORDS takes precedence over NO REPEAT,
+// which takes precedence over the offline tier.
+template <VariationDirection direction, SkewClass skewClass, typename RandomType>
+int varyNoteOn(NoteHistory& history, const NoteOptions& options, int noteNumber, int velocity,
+               std::int64_t position, const VelocitySettings& settings, RandomType& random) noexcept
+{
+    if (options.chords)
+        return getChordVelocity<direction, skewClass>(history.chordGroup, velocity, position, options, settings, random);
+
+    if (options.antiRepeat)
+        return getNonRepeatingVelocity<direction, skewClass>(history.recentVelocities, noteNumber, velocity, settings, random);
+
+    return options.offlineQuality ?
+        getStratifiedVelocity<direction, skewClass>(history.stratifiedDraws, velocity, settings, random) :
+        getVariedVelocity<direction, skewClass>(velocity, settings, random);
+}
+
+//==============================================================================
+// Every compile-time specialisation of a per-note loop, for looking one up by the
+// runtime settings. KernelOf<baseMode, direction, skewClass>::value is the loop for
+// those modes; all of them must have the same type.
+template <template <BaseMode, VariationDirection, SkewClass> class KernelOf>
+struct KernelTable
+{
+    static constexpr size_t numBaseModes = 3, numDirections = 3, numSkewClasses = 3;
+
+    using Kernel = std::remove_cv_t<decltype(KernelOf<BaseMode::input, VariationDirection::up, SkewClass::flat>::value)>;
+
+    static Kernel get(BaseMode baseMode, VariationDirection direction, SkewClass skewClass) noexcept
+    {
+        static constexpr auto kernels = make(std::make_index_sequence<numBaseModes * numDirections * numSkewClasses>());
+        return kernels[((size_t) baseMode * numDirections + (size_t) direction) * numSkewClasses + (size_t) skewClass];
+    }
+
+private:
+    template <size_t... index>
+    static constexpr std::array<Kernel, sizeof...(index)> make(std::index_sequence<index...>) noexcept
+    {
+        return { KernelOf<(BaseMode) (index / (numDirections * numSkewClasses)),
+                          (VariationDirection) ((index / numSkewClasses) % numDirections),
+                          (SkewClass) (index % numSkewClasses)>::value... };
+    }
+};
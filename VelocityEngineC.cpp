@@ -0,0 +1,224 @@
+/*
+  ==============================================================================
+
+    The C interface in VelocityEngineC.h, over VelocityEngine.h. Like the
+    plugin, an engine picks one compile-time specialisation of its inner loop
+    whenever the settings change, so the per-note path has no mode branches.
+
+  ==============================================================================
+*/
+
+#include "VelocityEngineC.h"
+#include "VelocityEngine.h"
+#include "CounterRandom.h"
+
+#include <array>
+#include <new>
+
+//==============================================================================
+struct mvv_engine
+{
+    using Kernel = int (*)(mvv_engine&, std::uint8_t*, size_t, std::int64_t);
+
+    double sampleRate = 44100.0;
+    Kernel kernel = nullptr;
+
+    VelocitySettings settings;
+    NoteOptions options;
+    std::uint64_t seed = 0;
+
+    std::array<unsigned char, 128> curve;
+    std::array<NoteHistory, 16> histories;     // one per MIDI channel
+};
+
+namespace
+{
+    template <BaseMode baseMode, VariationDirection direction, SkewClass skewClass>
+    int processBytes(mvv_engine& engine, std::uint8_t* bytes, size_t numBytes, std::int64_t position) noexcept
+    {
+        int noteOnsModified = 0;
+        std::uint8_t status = 0;    // running status, 0 when there is none
+
+        for (size_t i = 0; i < numBytes;)
+        {
+            const auto byte = bytes[i];
+
+            // real-time messages are single bytes and leave running status alone
+            if (byte >= 0xf8)
+            {
+                ++i;
+                continue;
+            }
+
+            // sysex, up to and including its end byte
+            if (byte == 0xf0)
+            {
+                while (i < numBytes && bytes[i] != 0xf7)
+                    ++i;
+
+                ++i;
+                status = 0;
+                continue;
+            }
+
+            // the other system common messages cancel running status
+            if (byte >= 0xf0)
+            {
+                i += 1 + (byte == 0xf2 ? 2 : (byte == 0xf1 || byte == 0xf3 ? 1 : 0));
+                status = 0;
+                continue;
+            }
+
+            if ((byte & 0x80) != 0)
+            {
+                status = byte;
+                ++i;
+            }
+            else if (status == 0)
+            {
+                ++i;    // a stray data byte
+                continue;
+            }
+
+            const auto type = status & 0xf0;
+            const size_t numDataBytes = (type == 0xc0 || type == 0xd0) ? 1 : 2;
+
+            // the data bytes, stepping over real-time bytes interleaved with them
+            size_t dataIndex[2] = {};
+            size_t numFound = 0;
+            auto next = i;
+
+            for (; next < numBytes && numFound < numDataBytes; ++next)
+            {
+                if (bytes[next] >= 0xf8)
+                    continue;
+
+                if ((bytes[next] & 0x80) != 0)
+                    break;      // a status byte cut this message short
+
+                dataIndex[numFound++] = next;
+            }
+
+            i = next;
+
+            if (numFound < numDataBytes)
+                continue;       // incomplete: the loop ends, or handles the interrupting status byte
+
+            if (type != 0x90)
+                continue;
+
+            const auto inputVelocity = bytes[dataIndex[1]] & 0x7f;
+
+            if (inputVelocity != 0)
+            {
+                const auto channel = status & 0x0f;
+                const auto noteNumber = bytes[dataIndex[0]] & 0x7f;
+                auto& history = engine.histories[(size_t) channel];
+                auto settings = engine.settings;
+
+                const auto velocity = getNoteOnBase<baseMode, direction>(history, engine.options, noteNumber, channel,
+                                                                         inputVelocity, position, settings);
+
+                // the same key as the plugin's FIXED SEED mode gives this note
+                CounterRandom random(engine.seed, position, noteNumber, channel + 1);
+                const auto varied = clampVelocity(varyNoteOn<direction, skewClass>(history, engine.options, noteNumber,
+                                                                                   velocity, position, settings, random));
+
+                if (varied != inputVelocity)
+                    ++noteOnsModified;
+
+                bytes[dataIndex[1]] = (std::uint8_t) varied;
+            }
+        }
+
+        return noteOnsModified;
+    }
+
+    template <BaseMode baseMode, VariationDirection direction, SkewClass skewClass>
+    struct BytesKernel
+    {
+        static constexpr mvv_engine::Kernel value = &processBytes<baseMode, direction, skewClass>;
+    };
+
+    int clampTo(int value, int low, int high) noexcept
+    {
+        return value < low ? low : (value > high ? high : value);
+    }
+}
+
+//==============================================================================
+void mvv_default_settings(mvv_settings* settings)
+{
+    *settings = {};
+    settings->range = 10;
+    settings->intensity = 1;
+    settings->direction = MVV_DIRECTION_UP;
+    settings->base_value = 84;
+    settings->chord_window_ms = 10;
+    settings->chord_spread = 3;
+}
+
+mvv_engine* mvv_engine_create(double sample_rate)
+{
+    auto* engine = new (std::nothrow) mvv_engine();
+
+    if (engine == nullptr)
+        return nullptr;
+
+    engine->sampleRate = sample_rate > 0.0 ? sample_rate : 44100.0;
+
+    mvv_settings settings;
+    mvv_default_settings(&settings);
+    mvv_engine_set_settings(engine, &settings);
+    mvv_engine_set_curve(engine, nullptr);
+    mvv_engine_reset(engine);
+
+    return engine;
+}
+
+void mvv_engine_destroy(mvv_engine* engine)
+{
+    delete engine;
+}
+
+void mvv_engine_set_settings(mvv_engine* engine, const mvv_settings* settings)
+{
+    engine->settings.range = clampTo(settings->range, 0, 127);
+    engine->settings.skew = clampTo(settings->intensity, 0, 5);
+    engine->settings.baseValue = clampTo(settings->base_value, 0, 127);
+    engine->settings.curve = engine->curve.data();
+    engine->seed = settings->seed;
+
+    engine->options.antiRepeat = settings->no_repeat != 0;
+    engine->options.chords = settings->chords != 0;
+    engine->options.chordWindow = (std::int64_t) (clampTo(settings->chord_window_ms, 0, 50) * 0.001 * engine->sampleRate);
+    engine->options.chordSpread = clampTo(settings->chord_spread, 0, 16);
+    engine->options.repetitionAmount = clampTo(settings->fast_repeats, 0, 100);
+    engine->options.fastInterval = (std::int64_t) (0.25 * engine->sampleRate);     // repeats faster than 1/4 s count as fast
+    engine->options.offlineQuality = settings->offline_quality != 0;
+
+    const auto baseMode = settings->use_base_value != 0 ? BaseMode::fixed
+                        : settings->adaptive != 0   ? BaseMode::adaptive
+                                                    : BaseMode::input;
+
+    engine->kernel = KernelTable<BytesKernel>::get(baseMode,
+                                                   (VariationDirection) clampTo((int) settings->direction, 0, 2),
+                                                   getSkewClass(engine->settings.skew));
+}
+
+void mvv_engine_set_curve(mvv_engine* engine, const uint8_t* curve)
+{
+    for (int v = 0; v < 128; ++v)
+        engine->curve[(size_t) v] = (unsigned char) clampVelocity(curve != nullptr ? curve[v] : v);
+}
+
+void mvv_engine_reset(mvv_engine* engine)
+{
+    for (auto& history : engine->histories)
+        history.reset();
+}
+
+int mvv_engine_process(mvv_engine* engine, uint8_t* bytes, size_t num_bytes, int64_t position)
+{
+    return engine->kernel(*engine, bytes, num_bytes, position);
+}
@@ -0,0 +1,86 @@
+/*
+  ==============================================================================
+
+    Plain C interface to the velocity humanizer, for hosts that can't link
+    JUCE: sequencer engines, embedded boxes, other languages' FFIs.
+
+    An engine varies note-on velocities in place in a span of raw MIDI bytes,
+    with the same kernels as the plugin's FIXED SEED mode: a note's velocity is
+    a pure function of the seed, its position, note and channel, plus the note
+    history when NO REPEAT, CHORDS or FAST REPEATS are on. Running status,
+    system and real-time bytes are understood and passed through untouched,
+    real-time ones even in the middle of a message. An incomplete message at
+    the end of the span is left alone.
+    Each MIDI channel keeps its own note history.
+
+    Only mvv_engine_create() allocates. Everything else is wait free and safe
+    on a real-time thread, but an engine is not thread safe: give each thread
+    its own, or serialise calls.
+
+    Build VelocityEngineC.cpp as C++17 with nothing but the standard library:
+
+        c++ -std=c++17 -O2 -c VelocityEngineC.cpp
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mvv_engine mvv_engine;
+
+typedef enum mvv_direction
+{
+    MVV_DIRECTION_UP = 0,
+    MVV_DIRECTION_CENTRED = 1,
+    MVV_DIRECTION_DOWN = 2
+} mvv_direction;
+
+/* The plugin's parameters, out-of-range values are clamped */
+typedef struct mvv_settings
+{
+    int range;                  /* RANGE, 0..127 */
+    int intensity;              /* INTENSITY, 0..5 */
+    mvv_direction direction;
+    int use_base_value;         /* 0 varies the incoming velocity (AUTO), 1 starts from base_value */
+    int base_value;             /* 0..127 */
+    int adaptive;               /* ADAPTIVE, 0 or 1: with use_base_value 0, range follows each channel's own dynamics */
+    uint64_t seed;
+
+    int no_repeat;              /* NO REPEAT, 0 or 1 */
+    int chords;                 /* CHORDS, 0 or 1 */
+    int chord_window_ms;        /* WINDOW, 0..50 */
+    int chord_spread;           /* SPREAD, 0..16 */
+    int fast_repeats;           /* FAST REPEATS, percent 0..100 */
+    int offline_quality;        /* 1 for the plugin's offline render tier: same distribution, no bunching, 8 draws a note */
+} mvv_settings;
+
+/* The plugin's defaults */
+void mvv_default_settings(mvv_settings* settings);
+
+/* Positions passed to mvv_engine_process() count samples at this rate. NULL if out of memory. */
+mvv_engine* mvv_engine_create(double sample_rate);
+void mvv_engine_destroy(mvv_engine* engine);
+
+void mvv_engine_set_settings(mvv_engine* engine, const mvv_settings* settings);
+
+/* 128 output velocities, one per input velocity, applied before the variation when
+   use_base_value is 0. NULL restores the straight line. */
+void mvv_engine_set_curve(mvv_engine* engine, const uint8_t* curve);
+
+/* Forgets the note history, like the plugin does when playback restarts */
+void mvv_engine_reset(mvv_engine* engine);
+
+/* Varies every note-on in bytes in place, all of them taken to happen at position.
+   Returns the number of note-ons whose velocity changed. */
+int mvv_engine_process(mvv_engine* engine, uint8_t* bytes, size_t num_bytes, int64_t position);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,138 @@
+/*
+  ==============================================================================
+
+    The velocity variation maths, specialised at compile time on each mode.
+
+    processBlock() picks one instantiation per block, so the per-note path has
+    no BASE, DIRECTION or INTENSITY branches left in it.
+
+    Target distributions of the random offset, for RANGE r:
+      INTENSITY 0     uniform on 0 .. r-1
+      INTENSITY 1-4   uniform on 0 .. r-1, plus INTENSITY more draws uniform on
+                      0 .. r/5-1, saturating at r (skews towards larger offsets)
+      INTENSITY 5     exactly 0 or r, with equal probability
+    DIRECTION then adds the offset (Up), subtracts it (Down), or adds it to
+    velocity - r/2 (Centred). The final velocity is clamped to 1..127.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+enum class BaseMode { input, fixed, adaptive };         // AUTO, BASE VALUE, AUTO with ADAPTIVE on
+enum class VariationDirection { up, centred, down };
+enum class SkewClass { flat, stacked, extremes };       // INTENSITY 0, 1-4, 5
+
+inline SkewClass getSkewClass(int skew) noexcept
+{
+    return skew == 0 ? SkewClass::flat
+         : skew == 5 ? SkewClass::extremes
+                     : SkewClass::stacked;
+}
+
+// Parameter values read once per block
+struct VelocitySettings
+{
+    int range = 0;
+    int skew = 0;
+    int baseValue = 0;
+    const unsigned char* curve = nullptr;   // 128 entry transfer curve for input velocities
+};
+
+//==============================================================================
+// nextInt() for a bound that may be 0 (RANGE below 5): returns 0 but still consumes
+// one draw, so the random stream doesn't shift with the settings
+template <typename RandomType>
+inline int nextIntBelow(RandomType& random, int maxValue) noexcept
+{
+    return random.nextInt(maxValue > 0 ? maxValue : 1);
+}
+
+template <SkewClass skewClass, typename RandomType>
+inline int getRandomOffset(const VelocitySettings& s, RandomType& random) noexcept
+{
+    // always take the first draw, so every class consumes the random stream the same way
+    auto rand = nextIntBelow(random, s.range);
+
+    if constexpr (skewClass == SkewClass::extremes)
+    {
+        rand = (random.nextInt(2) == 0) ? 0 : s.range;
+    }
+    else if constexpr (skewClass == SkewClass::stacked)
+    {
+        for (int x = 0; x < s.skew; x++)
+        {
+            const auto stacked = rand + nextIntBelow(random, s.range / 5);
+            rand = stacked < s.range ? stacked : s.range;
+        }
+    }
+
+    return rand;
+}
+
+template <VariationDirection direction>
+inline int applyOffset(int velocity, int offset, const VelocitySettings& s) noexcept
+{
+    if constexpr (direction == VariationDirection::up)
+        return velocity + offset;
+    else if constexpr (direction == VariationDirection::centred)
+        return velocity - s.range / 2 + offset;
+    else
+        return velocity - offset;
+}
+
+template <VariationDirection direction, SkewClass skewClass, typename RandomType>
+inline int getVariedVelocity(int velocity, const VelocitySettings& s, RandomType& random) noexcept
+{
+    return applyOffset<direction>(velocity, getRandomOffset<skewClass>(s, random), s);
+}
+
+// A note-on velocity can't be 0 (that's a note-off) or wrap past 127
+inline int clampVelocity(int velocity) noexcept
+{
+    return velocity < 1 ? 1 : (velocity > 127 ? 127 : velocity);
+}
+
+template <BaseMode baseMode>
+inline int getBaseVelocity(int inputVelocity, const VelocitySettings& s) noexcept
+{
+    if constexpr (baseMode == BaseMode::fixed)
+        return s.baseValue;
+    else
+        return s.curve[inputVelocity & 127];
+}
+
+//==============================================================================
+// How fast a note is being repeated: 0 for the first hit or hits at least fastInterval
+// apart, rising to 1 as the interval between hits on the same note approaches zero
+inline float getRepetitionSpeed(long long interval, long long fastInterval) noexcept
+{
+    if (interval < 0 || interval >= fastInterval || fastInterval <= 0)
+        return 0.0f;
+
+    return 1.0f - (float) interval / (float) fastInterval;
+}
+
+// Fast repeats lose accent and consistency: pull the velocity down and widen RANGE,
+// by up to maxAccentLoss and half the range again at full speed and amount
+inline void applyRepetitionSpeed(int& velocity, VelocitySettings& s, float speed, int amountPercent) noexcept
+{
+    constexpr int maxAccentLoss = 24;
+    const auto amount = speed * (float) amountPercent * 0.01f;
+
+    velocity -= (int) (amount * (float) maxAccentLoss + 0.5f);
+
+    const auto widened = (int) ((float) s.range * (1.0f + amount * 0.5f) + 0.5f);
+    s.range = widened < 127 ? widened : 127;
+}
+
+// Louder sidechain audio pushes velocities up, quieter pulls them down, by at most
+// maxSidechainBias at full amount. level is normalised to 0..1
+inline int getSidechainBias(float level, int amountPercent) noexcept
+{
+    constexpr float maxSidechainBias = 32.0f;
+    const auto bias = (2.0f * level - 1.0f) * (float) amountPercent * 0.01f * maxSidechainBias;
+
+    return (int) (bias < 0.0f ? bias - 0.5f : bias + 0.5f);
+}